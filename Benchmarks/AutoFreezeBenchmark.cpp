@@ -0,0 +1,526 @@
+/*
+  ==============================================================================
+
+    AutoFreezeBenchmark.cpp
+
+    Times every AutoFreezeState path of the engine across block sizes, sample
+    rates and channel counts, and reports the mean, p99 and worst block as a
+    percentage of the real-time budget for that block.
+
+    Each configuration plays bursts of noise through the engine, so every
+    block is timed in whichever state the engine really was in. The analysis
+    and first grains of a capture are spread over the last Reading Freeze
+    blocks, and the block that finishes a capture is reported as "Capture".
+    Grain resynthesis runs on the GrainPool worker, so it's timed on its own
+    against the time between two grain wraps.
+
+    The engine runs much faster than real time here, so the worker falls
+    behind and grain underruns in the output are expected. With enough
+    channels the capture goes to the engine's worker pool, and the benchmark
+    waits for it, so "Capture" then covers the whole parallel capture.
+
+    Every heap allocation is counted too, and the footprint and prepare time
+    of one engine are reported for each sample rate and channel count, then
+    again for a second engine alongside it, which shares the first one's
+    tables.
+
+    Usage: AutoFreezeBenchmark [--full] [--block-sizes 16,64,...]
+                               [--sample-rates 44100,...] [--channels 1,2,...]
+                               [--cycles n] [--json file] [--csv file]
+                               [--max-budget-percent p]
+                               [--channel-mode independent|linked|midside]
+                               [--freeze-order 11..17] [--layers n]
+                               [--morph seconds] [--compact]
+                               [--synthesis grains|streaming]
+
+  ==============================================================================
+*/
+
+#include "AutoFreezeEngine.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+//==============================================================================
+// Every allocation carries a header in front of it with its size and the
+// block malloc returned, so the bytes in use can be counted whichever thread
+// allocates them, and every form of new and delete goes through the same two
+// functions.
+namespace
+{
+    std::atomic<std::int64_t> liveHeapBytes { 0 };
+
+    struct AllocationHeader
+    {
+        void* block;
+        std::size_t numBytes;
+    };
+
+    void* allocateCounted (std::size_t numBytes, std::size_t alignment) noexcept
+    {
+        alignment = std::max (alignment, alignof (AllocationHeader));
+        auto* block = static_cast<unsigned char*> (std::malloc (sizeof (AllocationHeader) + alignment + numBytes));
+
+        if (block == nullptr)
+            return nullptr;
+
+        const auto start = reinterpret_cast<std::uintptr_t> (block) + sizeof (AllocationHeader);
+        auto* pointer = block + ((start + alignment - 1) / alignment * alignment - reinterpret_cast<std::uintptr_t> (block));
+
+        const AllocationHeader header { block, numBytes };
+        std::memcpy (pointer - sizeof (AllocationHeader), &header, sizeof (header));
+        liveHeapBytes += static_cast<std::int64_t> (numBytes);
+        return pointer;
+    }
+
+    void freeCounted (void* pointer) noexcept
+    {
+        if (pointer == nullptr)
+            return;
+
+        AllocationHeader header;
+        std::memcpy (&header, static_cast<unsigned char*> (pointer) - sizeof (AllocationHeader), sizeof (header));
+        liveHeapBytes -= static_cast<std::int64_t> (header.numBytes);
+        std::free (header.block);
+    }
+
+    void* allocateCountedOrThrow (std::size_t numBytes, std::size_t alignment)
+    {
+        if (auto* pointer = allocateCounted (numBytes, alignment))
+            return pointer;
+
+        throw std::bad_alloc();
+    }
+
+    constexpr std::size_t defaultAlignment = alignof (std::max_align_t);
+}
+
+void* operator new (std::size_t numBytes)                                                  { return allocateCountedOrThrow (numBytes, defaultAlignment); }
+void* operator new[] (std::size_t numBytes)                                                { return allocateCountedOrThrow (numBytes, defaultAlignment); }
+void* operator new (std::size_t numBytes, std::align_val_t alignment)                      { return allocateCountedOrThrow (numBytes, static_cast<std::size_t> (alignment)); }
+void* operator new[] (std::size_t numBytes, std::align_val_t alignment)                    { return allocateCountedOrThrow (numBytes, static_cast<std::size_t> (alignment)); }
+void* operator new (std::size_t numBytes, const std::nothrow_t&) noexcept                  { return allocateCounted (numBytes, defaultAlignment); }
+void* operator new[] (std::size_t numBytes, const std::nothrow_t&) noexcept                { return allocateCounted (numBytes, defaultAlignment); }
+void* operator new (std::size_t numBytes, std::align_val_t alignment, const std::nothrow_t&) noexcept   { return allocateCounted (numBytes, static_cast<std::size_t> (alignment)); }
+void* operator new[] (std::size_t numBytes, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocateCounted (numBytes, static_cast<std::size_t> (alignment)); }
+
+void operator delete (void* pointer) noexcept                                              { freeCounted (pointer); }
+void operator delete[] (void* pointer) noexcept                                            { freeCounted (pointer); }
+void operator delete (void* pointer, std::size_t) noexcept                                 { freeCounted (pointer); }
+void operator delete[] (void* pointer, std::size_t) noexcept                               { freeCounted (pointer); }
+void operator delete (void* pointer, std::align_val_t) noexcept                            { freeCounted (pointer); }
+void operator delete[] (void* pointer, std::align_val_t) noexcept                          { freeCounted (pointer); }
+void operator delete (void* pointer, std::size_t, std::align_val_t) noexcept               { freeCounted (pointer); }
+void operator delete[] (void* pointer, std::size_t, std::align_val_t) noexcept             { freeCounted (pointer); }
+void operator delete (void* pointer, const std::nothrow_t&) noexcept                       { freeCounted (pointer); }
+void operator delete[] (void* pointer, const std::nothrow_t&) noexcept                     { freeCounted (pointer); }
+void operator delete (void* pointer, std::align_val_t, const std::nothrow_t&) noexcept     { freeCounted (pointer); }
+void operator delete[] (void* pointer, std::align_val_t, const std::nothrow_t&) noexcept   { freeCounted (pointer); }
+
+//==============================================================================
+namespace
+{
+    struct Options
+    {
+        std::vector<int> blockSizes { 16, 64, 256, 1024, 4096 };
+        std::vector<double> sampleRates { 44100.0, 48000.0, 96000.0, 192000.0 };
+        std::vector<int> channelCounts { 1, 2, 8, 16 };
+        int cycles = 2;
+        std::string jsonPath;
+        std::string csvPath;
+        double maxBudgetPercent = 0.0;
+        ChannelMode channelMode = ChannelMode::Independent;
+        int freezeOrder = AutoFreezeEngine::defaultFreezeOrder;
+        int numLayers = 1;
+        float morphSeconds = 0.0f;
+        bool compact = false;
+        AutoFreezeEngine::Synthesis synthesis = AutoFreezeEngine::Synthesis::Grains;
+    };
+
+    struct Result
+    {
+        std::string path;
+        double sampleRate;
+        int blockSize;
+        int channels;
+        size_t count;
+        double meanUs, p99Us, maxUs;
+        double budgetUs;
+        int underruns;
+    };
+
+    struct Footprint
+    {
+        double sampleRate;
+        int channels;
+        std::int64_t bytes;
+        std::int64_t furtherBytes;
+        double prepareMs;
+        double furtherPrepareMs;
+    };
+
+    // burst lengths, chosen so one cycle passes through every state
+    constexpr double burstSeconds = 0.5;
+    constexpr double cycleSeconds = 2.0;
+    constexpr float burstGain = 0.5f;
+
+    template <typename Number>
+    std::vector<Number> parseList (const char* text)
+    {
+        std::vector<Number> values;
+
+        for (const char* p = text; *p != 0;)
+        {
+            char* end;
+            values.push_back (static_cast<Number> (std::strtod (p, &end)));
+            p = (*end == ',') ? end + 1 : end;
+
+            if (end == p && *end != 0)
+                break;
+        }
+
+        return values;
+    }
+
+    Result summarise (const std::string& path, std::vector<double>& timesUs, double budgetUs,
+                      double sampleRate, int blockSize, int channels, int underruns)
+    {
+        std::sort (timesUs.begin(), timesUs.end());
+
+        double sum = 0.0;
+
+        for (double t : timesUs)
+            sum += t;
+
+        const size_t n = timesUs.size();
+        const size_t p99Index = n == 0 ? 0 : std::min (n - 1, static_cast<size_t> (0.99 * static_cast<double> (n)));
+
+        return { path, sampleRate, blockSize, channels, n,
+                 n == 0 ? 0.0 : sum / static_cast<double> (n),
+                 n == 0 ? 0.0 : timesUs[p99Index],
+                 n == 0 ? 0.0 : timesUs.back(),
+                 budgetUs, underruns };
+    }
+
+    //==============================================================================
+    void configure (AutoFreezeEngine& engine, const Options& options)
+    {
+        engine.setDeterministicSeed (1);
+        engine.setChannelMode (options.channelMode);
+        engine.setFreezeOrder (options.freezeOrder);
+        engine.setLargestFreezeOrder (std::max (options.freezeOrder, AutoFreezeEngine::defaultFreezeOrder));
+        engine.setNumLayers (options.numLayers);
+        engine.setMorphSeconds (options.morphSeconds);
+        engine.setCompactMemory (options.compact);
+        engine.setSynthesis (options.synthesis);
+    }
+
+    // What an engine holds on to once it's prepared for the largest block
+    // size, and how long that takes. The first engine builds the shared
+    // tables, the second finds them already there.
+    Footprint measureFootprint (const Options& options, double sampleRate, int channels)
+    {
+        using Clock = std::chrono::steady_clock;
+        const int blockSize = *std::max_element (options.blockSizes.begin(), options.blockSizes.end());
+        std::array<std::unique_ptr<AutoFreezeEngine>, 2> engines;
+        std::array<std::int64_t, 2> bytes {};
+        std::array<double, 2> prepareMs {};
+
+        for (size_t i = 0; i < engines.size(); i++)
+        {
+            const auto bytesBefore = liveHeapBytes.load();
+            const auto start = Clock::now();
+
+            engines[i] = std::make_unique<AutoFreezeEngine>();
+            configure (*engines[i], options);
+            engines[i]->prepare (sampleRate, blockSize, channels);
+
+            prepareMs[i] = std::chrono::duration<double, std::milli> (Clock::now() - start).count();
+            bytes[i] = liveHeapBytes.load() - bytesBefore;
+        }
+
+        return { sampleRate, channels, bytes[0], bytes[1], prepareMs[0], prepareMs[1] };
+    }
+
+    void benchmarkStates (const Options& options, double sampleRate, int blockSize, int channels,
+                          std::vector<Result>& results)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        AutoFreezeEngine engine;
+        configure (engine, options);
+        engine.prepare (sampleRate, blockSize, channels);
+
+        SampleBuffer buffer (channels, blockSize);
+        std::minstd_rand random (1);
+        std::uniform_real_distribution<float> noise (-burstGain, burstGain);
+
+        const auto cycleSamples = static_cast<long> (cycleSeconds * sampleRate);
+        const auto burstSamples = static_cast<long> (burstSeconds * sampleRate);
+        const long totalBlocks = options.cycles * cycleSamples / blockSize;
+
+        std::map<std::string, std::vector<double>> timesUs;
+        long position = 0;
+
+        for (long block = 0; block < totalBlocks; block++)
+        {
+            for (int channel = 0; channel < channels; channel++)
+            {
+                float* data = buffer.getWritePointer (channel);
+
+                for (int i = 0; i < blockSize; i++)
+                    data[i] = (position + i) % cycleSamples < burstSamples ? noise (random) : 0.0f;
+            }
+
+            position += blockSize;
+
+            const auto stateBefore = engine.getState();
+
+            // only the parallel capture waits when non-realtime in this state
+            engine.setNonRealtime (stateBefore == AutoFreezeState::ReadingFreeze);
+            const auto start = Clock::now();
+            engine.process (buffer.getArrayOfWritePointers(), channels, blockSize);
+            const auto end = Clock::now();
+            const auto stateAfter = engine.getState();
+
+            const bool captured = stateBefore == AutoFreezeState::ReadingFreeze && stateAfter == AutoFreezeState::Cooldown;
+            const std::string path = captured ? "Capture" : getStateName (stateAfter);
+            timesUs[path].push_back (std::chrono::duration<double, std::micro> (end - start).count());
+        }
+
+        const double budgetUs = 1.0e6 * blockSize / sampleRate;
+
+        for (auto& [path, times] : timesUs)
+            results.push_back (summarise (path, times, budgetUs, sampleRate, blockSize, channels,
+                                          engine.getNumGrainUnderruns()));
+    }
+
+    void benchmarkGrainResynthesis (const Options& options, double sampleRate, int channels, int repeats,
+                                    std::vector<Result>& results)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        const int grainSamples = 1 << options.freezeOrder;
+        Fft fft (options.freezeOrder);
+        Fft pairFft (options.freezeOrder + 1);
+        const std::vector<float> gains (static_cast<size_t> (channels), 1.0f);
+        SampleBuffer mags (channels, grainSamples);
+        GrainBuffer grain;
+        grain.setSize (channels, grainSamples, options.compact ? GrainBuffer::Format::Float16 : GrainBuffer::Format::Float32);
+        std::vector<float> fftData (static_cast<size_t> (2 * grainSamples));
+        RandomPhaseSpectrum phases;
+        phases.prepare (grainSamples / 2);
+
+        for (int channel = 0; channel < channels; channel++)
+            std::fill (mags.getWritePointer (channel), mags.getWritePointer (channel) + grainSamples, 1.0f);
+
+        std::vector<double> timesUs;
+
+        for (int i = 0; i < repeats; i++)
+        {
+            const auto start = Clock::now();
+            phases.randomise (1, 1, static_cast<std::uint64_t> (i));
+            GrainPool::synthesise (mags, options.channelMode, gains.data(), grain, fft, pairFft, fftData, phases);
+            const auto end = Clock::now();
+            timesUs.push_back (std::chrono::duration<double, std::micro> (end - start).count());
+        }
+
+        // one grain has to be ready every time a grain wraps
+        const int hopSamples = grainSamples / AutoFreezeEngine::numGrains;
+        const double budgetUs = 1.0e6 * hopSamples / sampleRate;
+        results.push_back (summarise ("GrainResynthesis", timesUs, budgetUs, sampleRate, hopSamples, channels, 0));
+    }
+
+    //==============================================================================
+    double percent (double us, double budgetUs)   { return 100.0 * us / budgetUs; }
+
+    void writeJson (const std::string& path, const std::vector<Result>& results)
+    {
+        FILE* file = std::fopen (path.c_str(), "w");
+
+        if (file == nullptr)
+        {
+            std::fprintf (stderr, "could not write %s\n", path.c_str());
+            return;
+        }
+
+        std::fprintf (file, "[\n");
+
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const auto& r = results[i];
+            std::fprintf (file,
+                          "  { \"path\": \"%s\", \"sampleRate\": %.0f, \"blockSize\": %d, \"channels\": %d, "
+                          "\"count\": %zu, \"budgetUs\": %.3f, \"meanUs\": %.3f, \"p99Us\": %.3f, \"maxUs\": %.3f, "
+                          "\"meanPercent\": %.4f, \"p99Percent\": %.4f, \"maxPercent\": %.4f, \"underruns\": %d }%s\n",
+                          r.path.c_str(), r.sampleRate, r.blockSize, r.channels, r.count, r.budgetUs,
+                          r.meanUs, r.p99Us, r.maxUs,
+                          percent (r.meanUs, r.budgetUs), percent (r.p99Us, r.budgetUs), percent (r.maxUs, r.budgetUs),
+                          r.underruns, i + 1 < results.size() ? "," : "");
+        }
+
+        std::fprintf (file, "]\n");
+        std::fclose (file);
+    }
+
+    void writeCsv (const std::string& path, const std::vector<Result>& results)
+    {
+        FILE* file = std::fopen (path.c_str(), "w");
+
+        if (file == nullptr)
+        {
+            std::fprintf (stderr, "could not write %s\n", path.c_str());
+            return;
+        }
+
+        std::fprintf (file, "path,sampleRate,blockSize,channels,count,budgetUs,meanUs,p99Us,maxUs,meanPercent,p99Percent,maxPercent,underruns\n");
+
+        for (const auto& r : results)
+            std::fprintf (file, "%s,%.0f,%d,%d,%zu,%.3f,%.3f,%.3f,%.3f,%.4f,%.4f,%.4f,%d\n",
+                          r.path.c_str(), r.sampleRate, r.blockSize, r.channels, r.count, r.budgetUs,
+                          r.meanUs, r.p99Us, r.maxUs,
+                          percent (r.meanUs, r.budgetUs), percent (r.p99Us, r.budgetUs), percent (r.maxUs, r.budgetUs),
+                          r.underruns);
+
+        std::fclose (file);
+    }
+
+    bool parseOptions (int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+
+            if (arg == "--full")
+            {
+                options.blockSizes = { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+                options.sampleRates = { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0 };
+                options.channelCounts = { 1, 2, 4, 6, 8, 12, 16 };
+            }
+            else if (arg == "--block-sizes" && hasValue)          options.blockSizes = parseList<int> (argv[++i]);
+            else if (arg == "--sample-rates" && hasValue)         options.sampleRates = parseList<double> (argv[++i]);
+            else if (arg == "--channels" && hasValue)             options.channelCounts = parseList<int> (argv[++i]);
+            else if (arg == "--cycles" && hasValue)               options.cycles = std::max (1, std::atoi (argv[++i]));
+            else if (arg == "--json" && hasValue)                 options.jsonPath = argv[++i];
+            else if (arg == "--csv" && hasValue)                  options.csvPath = argv[++i];
+            else if (arg == "--max-budget-percent" && hasValue)   options.maxBudgetPercent = std::atof (argv[++i]);
+            else if (arg == "--freeze-order" && hasValue)
+                options.freezeOrder = std::clamp (std::atoi (argv[++i]), AutoFreezeEngine::minFreezeOrder, AutoFreezeEngine::maxFreezeOrder);
+            else if (arg == "--layers" && hasValue)
+                options.numLayers = std::clamp (std::atoi (argv[++i]), 1, AutoFreezeEngine::maxNumLayers);
+            else if (arg == "--compact")                          options.compact = true;
+            else if (arg == "--morph" && hasValue)
+                options.morphSeconds = std::clamp (static_cast<float> (std::atof (argv[++i])), 0.0f, AutoFreezeEngine::maxMorphSeconds);
+            else if (arg == "--synthesis" && hasValue)
+            {
+                const std::string synthesis = argv[++i];
+
+                if (synthesis == "grains")          options.synthesis = AutoFreezeEngine::Synthesis::Grains;
+                else if (synthesis == "streaming")  options.synthesis = AutoFreezeEngine::Synthesis::Streaming;
+                else
+                {
+                    std::fprintf (stderr, "unknown synthesis %s\n", synthesis.c_str());
+                    return false;
+                }
+            }
+            else if (arg == "--channel-mode" && hasValue)
+            {
+                const std::string mode = argv[++i];
+
+                if (mode == "independent")      options.channelMode = ChannelMode::Independent;
+                else if (mode == "linked")      options.channelMode = ChannelMode::LinkedStereo;
+                else if (mode == "midside")     options.channelMode = ChannelMode::MidSide;
+                else
+                {
+                    std::fprintf (stderr, "unknown channel mode %s\n", mode.c_str());
+                    return false;
+                }
+            }
+            else
+            {
+                std::fprintf (stderr, "unknown or incomplete option %s\n", arg.c_str());
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+//==============================================================================
+int main (int argc, char** argv)
+{
+    Options options;
+
+    if (! parseOptions (argc, argv, options))
+        return 2;
+
+    if (options.blockSizes.empty())
+        options.blockSizes = { 512 };
+
+    std::vector<Result> results;
+    std::vector<Footprint> footprints;
+
+    for (double sampleRate : options.sampleRates)
+    {
+        for (int channels : options.channelCounts)
+        {
+            footprints.push_back (measureFootprint (options, sampleRate, channels));
+
+            for (int blockSize : options.blockSizes)
+                benchmarkStates (options, sampleRate, blockSize, channels, results);
+
+            benchmarkGrainResynthesis (options, sampleRate, channels, 20, results);
+        }
+    }
+
+    std::printf ("%-17s %8s %6s %4s %7s %9s %9s %9s %9s\n",
+                 "path", "rate", "block", "ch", "blocks", "mean %", "p99 %", "max %", "max us");
+
+    bool overBudget = false;
+
+    for (const auto& r : results)
+    {
+        std::printf ("%-17s %8.0f %6d %4d %7zu %9.3f %9.3f %9.3f %9.1f\n",
+                     r.path.c_str(), r.sampleRate, r.blockSize, r.channels, r.count,
+                     percent (r.meanUs, r.budgetUs), percent (r.p99Us, r.budgetUs), percent (r.maxUs, r.budgetUs),
+                     r.maxUs);
+
+        if (options.maxBudgetPercent > 0.0 && percent (r.p99Us, r.budgetUs) > options.maxBudgetPercent)
+            overBudget = true;
+    }
+
+    std::printf ("\n%-17s %8s %4s %12s %12s %10s %10s\n", "footprint", "rate", "ch", "KB", "next KB", "ms", "next ms");
+
+    for (const auto& f : footprints)
+        std::printf ("%-17s %8.0f %4d %12.1f %12.1f %10.2f %10.2f\n", options.compact ? "compact" : "standard",
+                     f.sampleRate, f.channels, static_cast<double> (f.bytes) / 1024.0,
+                     static_cast<double> (f.furtherBytes) / 1024.0, f.prepareMs, f.furtherPrepareMs);
+
+    if (! options.jsonPath.empty())
+        writeJson (options.jsonPath, results);
+
+    if (! options.csvPath.empty())
+        writeCsv (options.csvPath, results);
+
+    if (overBudget)
+    {
+        std::fprintf (stderr, "p99 block time exceeded %.1f%% of the real-time budget\n", options.maxBudgetPercent);
+        return 1;
+    }
+
+    return 0;
+}
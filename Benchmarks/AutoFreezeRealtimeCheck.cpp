@@ -0,0 +1,545 @@
+/*
+  ==============================================================================
+
+    AutoFreezeRealtimeCheck.cpp
+
+    Drives the engine the way processBlock does, through scripted scenarios,
+    and fails if the audio thread allocates or frees memory, locks a mutex,
+    waits on a semaphore, sleeps or makes a system call while it's inside
+    processBlock. Each violation is reported with a stack trace, and the exit
+    code is the number of scenarios that had any.
+
+    processBlock loads the parameters from atomics and hands them on, hands
+    the snapshot parameter and each MIDI message to the engine to recall
+    snapshots from, and calls process, and all of that is audited. What it
+    adds around them needs JUCE, so it isn't: ScopedNoDenormals,
+    ScopedAllocationGuard, the MidiBuffer iteration and the parameter
+    tree's own atomics.
+
+    The scenarios are silence, threshold crossings, a long hold with the
+    parameters automated, restores and snapshot recalls from a bank, by
+    index, by the snapshot parameter and by MIDI, block sizes that change
+    on every call, some larger than the engine was prepared for, and sample
+    rate changes, which prepare again. Everything between calls to
+    processBlock plays the part of the message thread, so it may allocate.
+
+    The checks interpose the C library's allocator and a set of blocking
+    calls, so this only builds against glibc. Build it without sanitisers,
+    which replace the allocator themselves.
+
+    Usage: AutoFreezeRealtimeCheck [--channels 1,2,...] [--layers n]
+                                   [--synthesis grains|streaming]
+                                   [--channel-mode independent|linked|midside]
+                                   [--freeze-order 11..17] [--morph seconds]
+                                   [--compact] [--max-reports n]
+
+  ==============================================================================
+*/
+
+#include "AutoFreezeEngine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+
+//==============================================================================
+// The audio thread is audited while it's inside process. A violation turns
+// the audit off while it's reported, since printing a stack trace writes,
+// and may allocate the first time.
+namespace
+{
+    thread_local bool auditing = false;
+    const char* currentScenario = "";
+    int numViolations = 0;
+    int numReports = 0;
+    int maxReports = 3;
+
+    void reportViolation (const char* call)
+    {
+        if (! auditing)
+            return;
+
+        auditing = false;
+        numViolations++;
+
+        if (numReports++ < maxReports)
+        {
+            std::fprintf (stderr, "\n%s on the audio thread during \"%s\"\n", call, currentScenario);
+
+            void* frames[64];
+            backtrace_symbols_fd (frames, backtrace (frames, 64), STDERR_FILENO);
+        }
+
+        auditing = true;
+    }
+
+    // the real calls, looked up before anything is audited
+    template <typename Function>
+    Function* findNext (const char* name)
+    {
+        return reinterpret_cast<Function*> (dlsym (RTLD_NEXT, name));
+    }
+
+    auto* nextMutexLock = findNext<int (pthread_mutex_t*)> ("pthread_mutex_lock");
+    auto* nextCondWait = findNext<int (pthread_cond_t*, pthread_mutex_t*)> ("pthread_cond_wait");
+    auto* nextCondTimedWait = findNext<int (pthread_cond_t*, pthread_mutex_t*, const timespec*)> ("pthread_cond_timedwait");
+    auto* nextSemWait = findNext<int (sem_t*)> ("sem_wait");
+    auto* nextSemTimedWait = findNext<int (sem_t*, const timespec*)> ("sem_timedwait");
+    auto* nextRead = findNext<ssize_t (int, void*, size_t)> ("read");
+    auto* nextWrite = findNext<ssize_t (int, const void*, size_t)> ("write");
+    auto* nextClose = findNext<int (int)> ("close");
+    auto* nextOpen = findNext<int (const char*, int, ...)> ("open");
+    auto* nextOpenAt = findNext<int (int, const char*, int, ...)> ("openat");
+    auto* nextNanosleep = findNext<int (const timespec*, timespec*)> ("nanosleep");
+    auto* nextClockNanosleep = findNext<int (clockid_t, int, const timespec*, timespec*)> ("clock_nanosleep");
+    auto* nextUsleep = findNext<int (useconds_t)> ("usleep");
+    auto* nextSchedYield = findNext<int()> ("sched_yield");
+    auto* nextSyscall = findNext<long (long, ...)> ("syscall");
+
+    // backtrace loads its unwinder on first use, which allocates
+    const bool unwinderLoaded = [] { void* frame; return backtrace (&frame, 1) >= 0; }();
+}
+
+//==============================================================================
+// glibc's own allocator is always there under these names, so the
+// replacements never need to look it up
+extern "C"
+{
+    void* __libc_malloc (size_t);
+    void* __libc_calloc (size_t, size_t);
+    void* __libc_realloc (void*, size_t);
+    void* __libc_memalign (size_t, size_t);
+    void __libc_free (void*);
+
+    void* malloc (size_t size)                          { reportViolation ("malloc"); return __libc_malloc (size); }
+    void* calloc (size_t count, size_t size)            { reportViolation ("calloc"); return __libc_calloc (count, size); }
+    void* realloc (void* p, size_t size)                { reportViolation ("realloc"); return __libc_realloc (p, size); }
+    void* memalign (size_t alignment, size_t size)      { reportViolation ("memalign"); return __libc_memalign (alignment, size); }
+    void* aligned_alloc (size_t alignment, size_t size) { reportViolation ("aligned_alloc"); return __libc_memalign (alignment, size); }
+
+    int posix_memalign (void** p, size_t alignment, size_t size)
+    {
+        reportViolation ("posix_memalign");
+        *p = __libc_memalign (alignment, size);
+        return *p != nullptr ? 0 : ENOMEM;
+    }
+
+    void free (void* p)
+    {
+        if (p != nullptr)
+            reportViolation ("free");
+
+        __libc_free (p);
+    }
+
+    int pthread_mutex_lock (pthread_mutex_t* m)         { reportViolation ("pthread_mutex_lock"); return nextMutexLock (m); }
+    int pthread_cond_wait (pthread_cond_t* c, pthread_mutex_t* m)   { reportViolation ("pthread_cond_wait"); return nextCondWait (c, m); }
+
+    int pthread_cond_timedwait (pthread_cond_t* c, pthread_mutex_t* m, const timespec* t)
+    {
+        reportViolation ("pthread_cond_timedwait");
+        return nextCondTimedWait (c, m, t);
+    }
+
+    // waking a background thread with sem_post is fine, waiting isn't
+    int sem_wait (sem_t* s)                                 { reportViolation ("sem_wait"); return nextSemWait (s); }
+    int sem_timedwait (sem_t* s, const timespec* t)         { reportViolation ("sem_timedwait"); return nextSemTimedWait (s, t); }
+
+    ssize_t read (int fd, void* data, size_t size)          { reportViolation ("read"); return nextRead (fd, data, size); }
+    ssize_t write (int fd, const void* data, size_t size)   { reportViolation ("write"); return nextWrite (fd, data, size); }
+    int close (int fd)                                      { reportViolation ("close"); return nextClose (fd); }
+
+    int open (const char* path, int flags, ...)
+    {
+        reportViolation ("open");
+        va_list args;
+        va_start (args, flags);
+        const auto mode = va_arg (args, unsigned int);
+        va_end (args);
+        return nextOpen (path, flags, mode);
+    }
+
+    int openat (int dir, const char* path, int flags, ...)
+    {
+        reportViolation ("openat");
+        va_list args;
+        va_start (args, flags);
+        const auto mode = va_arg (args, unsigned int);
+        va_end (args);
+        return nextOpenAt (dir, path, flags, mode);
+    }
+
+    int nanosleep (const timespec* t, timespec* left)       { reportViolation ("nanosleep"); return nextNanosleep (t, left); }
+    int usleep (useconds_t us)                              { reportViolation ("usleep"); return nextUsleep (us); }
+    int sched_yield()                                       { reportViolation ("sched_yield"); return nextSchedYield(); }
+
+    int clock_nanosleep (clockid_t clock, int flags, const timespec* t, timespec* left)
+    {
+        reportViolation ("clock_nanosleep");
+        return nextClockNanosleep (clock, flags, t, left);
+    }
+
+    // futex waits, from std::atomic::wait among others, come through here
+    long syscall (long number, ...)
+    {
+        reportViolation ("syscall");
+        va_list args;
+        va_start (args, number);
+        long a[6];
+
+        for (auto& arg : a)
+            arg = va_arg (args, long);
+
+        va_end (args);
+        return nextSyscall (number, a[0], a[1], a[2], a[3], a[4], a[5]);
+    }
+}
+
+//==============================================================================
+namespace
+{
+    struct Options
+    {
+        std::vector<int> channelCounts { 2, 8 };
+        int numLayers = 4;
+        AutoFreezeEngine::Synthesis synthesis = AutoFreezeEngine::Synthesis::Grains;
+        ChannelMode channelMode = ChannelMode::Independent;
+        int freezeOrder = AutoFreezeEngine::defaultFreezeOrder;
+        float morphSeconds = 0.0f;
+        bool compact = false;
+    };
+
+    constexpr int maxBlockSize = 512;
+    constexpr double sampleRates[] = { 44100.0, 48000.0, 96000.0, 192000.0 };
+    constexpr float burstGain = 0.5f;
+
+    template <typename Number>
+    std::vector<Number> parseList (const char* text)
+    {
+        std::vector<Number> values;
+
+        for (const char* p = text; *p != 0;)
+        {
+            char* end;
+            values.push_back (static_cast<Number> (std::strtod (p, &end)));
+            p = (*end == ',') ? end + 1 : end;
+
+            if (end == p && *end != 0)
+                break;
+        }
+
+        return values;
+    }
+
+    //==============================================================================
+    // Plays the host. The input is a tone whose gain the scenario sets for
+    // each block, and only processBlock is audited.
+    class Host
+    {
+    public:
+        // the raw parameter values processBlock loads, which the scenarios
+        // set as automation would
+        struct Parameters
+        {
+            std::atomic<float> thresholdDb { AutoFreezeEngine::defaultThresholdDb };
+            std::atomic<float> predelaySeconds { AutoFreezeEngine::defaultPredelaySeconds };
+            std::atomic<float> cooldownSeconds { AutoFreezeEngine::defaultCooldownSeconds };
+            std::atomic<float> shortFadeSeconds { AutoFreezeEngine::defaultShortFadeSeconds };
+            std::atomic<float> longFadeSeconds { AutoFreezeEngine::defaultLongFadeSeconds };
+            std::atomic<float> morphSeconds { 0.0f };
+            std::atomic<float> snapshot { 0.0f };
+        };
+
+        Host (const Options& optionsToUse, int channels)
+            : options (optionsToUse), numChannels (channels), buffer (channels, 4 * maxBlockSize)
+        {
+            engine.setDeterministicSeed (1);
+            engine.setNumLayers (options.numLayers);
+            engine.setSynthesis (options.synthesis);
+            engine.setChannelMode (options.channelMode);
+            engine.setFreezeOrder (options.freezeOrder);
+            engine.setLargestFreezeOrder (std::max (options.freezeOrder, AutoFreezeEngine::defaultFreezeOrder));
+            engine.setCompactMemory (options.compact);
+            parameters.morphSeconds = options.morphSeconds;
+            engine.setMorphSeconds (options.morphSeconds);
+        }
+
+        ~Host()
+        {
+            engine.setSnapshotBank (nullptr, 0);
+        }
+
+        void prepare (double newSampleRate)
+        {
+            sampleRate = newSampleRate;
+            engine.prepare (sampleRate, maxBlockSize, numChannels);
+        }
+
+        // a bank of the given snapshots, which the engine reads in place
+        bool openBank (const std::vector<std::vector<std::uint8_t>>& snapshots)
+        {
+            std::vector<std::size_t> sizes;
+
+            for (const auto& snapshot : snapshots)
+                sizes.push_back (snapshot.size());
+
+            engine.setSnapshotBank (nullptr, 0);
+            FreezeBank::writeIndex (sizes, bank);
+
+            for (const auto& snapshot : snapshots)
+                bank.insert (bank.end(), snapshot.begin(), snapshot.end());
+
+            return engine.setSnapshotBank (bank.data(), bank.size());
+        }
+
+        // what processBlock does
+        void processBlock (int numSamples, float gain)
+        {
+            for (int channel = 0; channel < numChannels; channel++)
+            {
+                float* data = buffer.getWritePointer (channel);
+
+                for (int i = 0; i < numSamples; i++)
+                    data[i] = gain * static_cast<float> (std::sin (phase + 0.03 * i));
+            }
+
+            phase = std::fmod (phase + 0.03 * numSamples, 2.0 * 3.141592653589793);
+
+            auditing = true;
+            engine.setNonRealtime (false);
+            engine.setThresholdDb (parameters.thresholdDb.load());
+            engine.setPredelaySeconds (parameters.predelaySeconds.load());
+            engine.setCooldownSeconds (parameters.cooldownSeconds.load());
+            engine.setShortFadeSeconds (parameters.shortFadeSeconds.load());
+            engine.setLongFadeSeconds (parameters.longFadeSeconds.load());
+            engine.setMorphSeconds (parameters.morphSeconds.load());
+            engine.setSnapshotParameter (static_cast<int> (parameters.snapshot.load()));
+
+            for (const auto& message : midiMessages)
+                engine.handleMidiMessage (message.data(), static_cast<int> (message.size()));
+
+            engine.process (buffer.getArrayOfWritePointers(), numChannels, numSamples);
+            auditing = false;
+
+            // the editor's part
+            AutoFreezeTelemetry frame;
+
+            while (engine.popTelemetry (frame)) {}
+
+            midiMessages.clear();
+        }
+
+        // seconds of blocks, with the gain of each from gainAt (seconds into the run)
+        void play (double seconds, const std::function<float (double)>& gainAt, int blockSize = 256)
+        {
+            for (double time = 0.0; time < seconds; time += blockSize / sampleRate)
+                processBlock (blockSize, gainAt (time));
+        }
+
+        AutoFreezeEngine engine;
+        Parameters parameters;
+        std::vector<std::vector<std::uint8_t>> midiMessages;    // for the next block
+        const Options& options;
+        const int numChannels;
+        double sampleRate = 48000.0;
+        SampleBuffer buffer;
+        double phase = 0.0;
+        std::vector<std::uint8_t> bank;
+    };
+
+    //==============================================================================
+    bool runScenario (const char* name, const std::function<void()>& scenario)
+    {
+        currentScenario = name;
+        const int violationsBefore = numViolations;
+        scenario();
+
+        const int violations = numViolations - violationsBefore;
+        std::printf ("%-28s %s", name, violations == 0 ? "ok\n" : "FAILED");
+
+        if (violations > 0)
+            std::printf (", %d violations\n", violations);
+
+        return violations == 0;
+    }
+
+    int runScenarios (const Options& options, int channels)
+    {
+        Host host (options, channels);
+        host.prepare (48000.0);
+        int numFailed = 0;
+
+        std::printf ("\n%d channels\n", channels);
+
+        numFailed += ! runScenario ("silence", [&] {
+            host.play (5.0, [] (double) { return 0.0f; });
+        });
+
+        numFailed += ! runScenario ("threshold crossings", [&] {
+            host.play (10.0, [] (double time) { return std::fmod (time, 1.25) < 0.4 ? burstGain : 0.0f; });
+        });
+
+        numFailed += ! runScenario ("long hold, automated", [&] {
+            auto& parameters = host.parameters;
+            host.play (0.5, [] (double) { return burstGain; });
+
+            for (double time = 0.0; time < 20.0; time += 256 / host.sampleRate)
+            {
+                const auto cycle = static_cast<float> (std::fmod (time, 2.0));
+                parameters.thresholdDb = -40.0f + 10.0f * cycle;
+                parameters.predelaySeconds = 0.05f + 0.1f * cycle;
+                parameters.cooldownSeconds = 0.5f + cycle;
+                parameters.shortFadeSeconds = 0.01f + 0.05f * cycle;
+                parameters.longFadeSeconds = 0.1f + 0.2f * cycle;
+                parameters.morphSeconds = 0.2f * cycle;
+                host.processBlock (256, 0.0f);
+            }
+
+            parameters.morphSeconds = options.morphSeconds;
+        });
+
+        numFailed += ! runScenario ("restores and recalls", [&] {
+            auto& engine = host.engine;
+            std::vector<std::uint8_t> state;
+            host.play (3.0, [] (double time) { return time < 0.5 ? burstGain : 0.0f; });
+
+            if (engine.getFreezeState (state, FreezeState::Encoding::Log16))
+            {
+                // the same freeze in every encoding, so each recall decodes differently
+                std::vector<std::vector<std::uint8_t>> snapshots (3);
+                engine.getFreezeState (snapshots[0], FreezeState::Encoding::Float32);
+                engine.getFreezeState (snapshots[1], FreezeState::Encoding::Linear16);
+                engine.getFreezeState (snapshots[2], FreezeState::Encoding::Log16);
+
+                if (! host.openBank (snapshots))
+                    std::fprintf (stderr, "could not open the snapshot bank\n");
+
+                // the last index of each round is past the end of the bank
+                for (int i = 0; i < 20; i++)
+                {
+                    engine.restoreFreezeState (state.data(), state.size());
+                    host.play (0.25, [] (double) { return 0.0f; });
+                    engine.recallSnapshot (i % 4);
+                    host.play (0.25, [] (double) { return 0.0f; });
+                    host.parameters.snapshot = static_cast<float> (1 + i % 4);
+                    host.play (0.25, [] (double) { return 0.0f; });
+                    host.midiMessages.push_back ({ 0xb0, 0, 0 });
+                    host.midiMessages.push_back ({ 0xc0, static_cast<std::uint8_t> (i % 4) });
+                    host.play (0.25, [] (double) { return 0.0f; });
+                }
+
+                host.parameters.snapshot = 0.0f;
+            }
+        });
+
+        numFailed += ! runScenario ("changing block sizes", [&] {
+            std::minstd_rand random (7);
+            double time = 0.0;
+
+            // up to twice the promised maximum, which a host may send
+            while (time < 10.0)
+            {
+                const int blockSize = 1 + static_cast<int> (random() % (2 * maxBlockSize));
+                host.processBlock (blockSize, std::fmod (time, 1.5) < 0.5 ? burstGain : 0.0f);
+                time += blockSize / host.sampleRate;
+            }
+        });
+
+        numFailed += ! runScenario ("changing sample rates", [&] {
+            for (double sampleRate : sampleRates)
+            {
+                host.prepare (sampleRate);
+                host.play (4.0, [] (double time) { return std::fmod (time, 2.0) < 0.5 ? burstGain : 0.0f; }, 128);
+            }
+        });
+
+        return numFailed;
+    }
+
+    bool parseOptions (int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+
+            if (arg == "--channels" && hasValue)                  options.channelCounts = parseList<int> (argv[++i]);
+            else if (arg == "--max-reports" && hasValue)          maxReports = std::max (0, std::atoi (argv[++i]));
+            else if (arg == "--compact")                          options.compact = true;
+            else if (arg == "--freeze-order" && hasValue)
+                options.freezeOrder = std::clamp (std::atoi (argv[++i]), AutoFreezeEngine::minFreezeOrder, AutoFreezeEngine::maxFreezeOrder);
+            else if (arg == "--layers" && hasValue)
+                options.numLayers = std::clamp (std::atoi (argv[++i]), 1, AutoFreezeEngine::maxNumLayers);
+            else if (arg == "--morph" && hasValue)
+                options.morphSeconds = std::clamp (static_cast<float> (std::atof (argv[++i])), 0.0f, AutoFreezeEngine::maxMorphSeconds);
+            else if (arg == "--synthesis" && hasValue)
+            {
+                const std::string synthesis = argv[++i];
+
+                if (synthesis == "grains")          options.synthesis = AutoFreezeEngine::Synthesis::Grains;
+                else if (synthesis == "streaming")  options.synthesis = AutoFreezeEngine::Synthesis::Streaming;
+                else
+                {
+                    std::fprintf (stderr, "unknown synthesis %s\n", synthesis.c_str());
+                    return false;
+                }
+            }
+            else if (arg == "--channel-mode" && hasValue)
+            {
+                const std::string mode = argv[++i];
+
+                if (mode == "independent")      options.channelMode = ChannelMode::Independent;
+                else if (mode == "linked")      options.channelMode = ChannelMode::LinkedStereo;
+                else if (mode == "midside")     options.channelMode = ChannelMode::MidSide;
+                else
+                {
+                    std::fprintf (stderr, "unknown channel mode %s\n", mode.c_str());
+                    return false;
+                }
+            }
+            else
+            {
+                std::fprintf (stderr, "unknown or incomplete option %s\n", arg.c_str());
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+//==============================================================================
+int main (int argc, char** argv)
+{
+    Options options;
+
+    if (! parseOptions (argc, argv, options))
+        return 2;
+
+    if (! unwinderLoaded)
+        std::fprintf (stderr, "stack traces are unavailable\n");
+
+    int numFailed = 0;
+
+    for (int channels : options.channelCounts)
+        numFailed += runScenarios (options, channels);
+
+    std::printf ("\n%d violations, %d scenarios failed\n", numViolations, numFailed);
+    return numFailed;
+}
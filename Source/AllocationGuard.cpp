@@ -0,0 +1,62 @@
+/*
+  ==============================================================================
+
+    AllocationGuard.cpp
+
+  ==============================================================================
+*/
+
+#include "AllocationGuard.h"
+
+#if JUCE_DEBUG
+
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+namespace
+{
+    thread_local int guardDepth = 0;
+}
+
+ScopedAllocationGuard::ScopedAllocationGuard()   { ++guardDepth; }
+ScopedAllocationGuard::~ScopedAllocationGuard()  { --guardDepth; }
+
+bool ScopedAllocationGuard::isActiveOnThisThread()
+{
+    return guardDepth > 0;
+}
+
+//==============================================================================
+// The default array, nothrow and sized forms all forward to these two, so
+// replacing them is enough to catch every unaligned allocation.
+void* operator new (std::size_t size)
+{
+    if (guardDepth > 0)
+    {
+        // the guard is lifted while asserting in case the assertion itself allocates
+        const auto depth = std::exchange (guardDepth, 0);
+        jassertfalse; // something allocated on the audio thread, check the call stack
+        guardDepth = depth;
+    }
+
+    if (void* p = std::malloc (size == 0 ? 1 : size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+// freeing memory can take the allocator's lock too
+void operator delete (void* p) noexcept
+{
+    if (p != nullptr && guardDepth > 0)
+    {
+        const auto depth = std::exchange (guardDepth, 0);
+        jassertfalse; // something freed memory on the audio thread, check the call stack
+        guardDepth = depth;
+    }
+
+    std::free (p);
+}
+
+#endif
@@ -0,0 +1,36 @@
+/*
+  ==============================================================================
+
+    AllocationGuard.h
+
+    In debug builds, asserts if operator new or delete is called on a thread
+    while a ScopedAllocationGuard is alive on it. Release builds compile this
+    away. Benchmarks/AutoFreezeRealtimeCheck goes further for the engine, and
+    catches locks and system calls as well.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+*/
+class ScopedAllocationGuard
+{
+public:
+   #if JUCE_DEBUG
+    ScopedAllocationGuard();
+    ~ScopedAllocationGuard();
+
+    static bool isActiveOnThisThread();
+   #else
+    ScopedAllocationGuard() {}
+    static bool isActiveOnThisThread() { return false; }
+   #endif
+
+private:
+    JUCE_DECLARE_NON_COPYABLE (ScopedAllocationGuard)
+};
@@ -0,0 +1,1699 @@
+/*
+  ==============================================================================
+
+    AutoFreezeEngine.cpp
+
+  ==============================================================================
+*/
+
+#include "AutoFreezeEngine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define AUTOFREEZE_OVERLAP_ADD_SSE2 1
+#elif defined (__ARM_NEON) || defined (__ARM_NEON__) || defined (_M_ARM64)
+ #include <arm_neon.h>
+ #define AUTOFREEZE_OVERLAP_ADD_NEON 1
+#endif
+
+//==============================================================================
+namespace
+{
+    float gainToDecibels(float gain)
+    {
+        constexpr float minusInfinityDb = -100.0f;
+        return gain > 0.0f ? std::max(minusInfinityDb, std::log10(gain) * 20.0f) : minusInfinityDb;
+    }
+
+    // at least one sample, so that every state lasts for some of the block
+    int secondsToSamples (float seconds, double sampleRate)
+    {
+        return std::max(1, static_cast<int>(std::lround(seconds * sampleRate)));
+    }
+
+    // maps a unit of an FFT pass onto an index in an array of count values
+    int unitToIndex (int unit, int numUnits, int count)
+    {
+        return static_cast<int>(static_cast<std::int64_t>(unit) * count / numUnits);
+    }
+
+    // dest[i] = from[i] + position * (to[i] - from[i]), dest may be from
+    void interpolate (float* dest, const float* from, const float* to, float position, int numValues)
+    {
+        for (int i = 0; i < numValues; i++)
+            dest[i] = from[i] + position * (to[i] - from[i]);
+    }
+
+    // grain samples, as floats whatever they're stored as
+    inline float loadSample (float sample) { return sample; }
+    inline float loadSample (std::uint16_t sample) { return GrainBuffer::halfToFloat(sample); }
+
+   #if AUTOFREEZE_OVERLAP_ADD_SSE2
+    inline __m128 loadSamples (const float* source) { return _mm_loadu_ps(source); }
+
+    inline __m128 loadSamples (const std::uint16_t* source)
+    {
+        const __m128i halves = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(source)), _mm_setzero_si128());
+        const __m128i sign = _mm_slli_epi32(_mm_and_si128(halves, _mm_set1_epi32(0x8000)), 16);
+        const __m128i magnitude = _mm_slli_epi32(_mm_and_si128(halves, _mm_set1_epi32(0x7fff)), 13);
+        const __m128 value = _mm_mul_ps(_mm_castsi128_ps(magnitude), _mm_set1_ps(5.192296858534828e33f));
+        return _mm_or_ps(value, _mm_castsi128_ps(sign));
+    }
+   #elif AUTOFREEZE_OVERLAP_ADD_NEON
+    inline float32x4_t loadSamples (const float* source) { return vld1q_f32(source); }
+
+    inline float32x4_t loadSamples (const std::uint16_t* source)
+    {
+        const uint32x4_t halves = vmovl_u16(vld1_u16(source));
+        const uint32x4_t sign = vshlq_n_u32(vandq_u32(halves, vdupq_n_u32(0x8000)), 16);
+        const uint32x4_t magnitude = vshlq_n_u32(vandq_u32(halves, vdupq_n_u32(0x7fff)), 13);
+        const float32x4_t value = vmulq_f32(vreinterpretq_f32_u32(magnitude), vdupq_n_f32(5.192296858534828e33f));
+        return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(value), sign));
+    }
+   #endif
+
+    // dest[i] = normalisation[i] * sum of grains[g][i] * windows[g][i], or
+    // that added to dest[i] when accumulating
+    template <int numOverlaps, bool accumulate, typename Sample>
+    void overlapAdd (float* dest, const Sample* const* grains, const float* const* windows, const float* normalisation, int numSamples)
+    {
+        int i = 0;
+
+       #if AUTOFREEZE_OVERLAP_ADD_SSE2
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            __m128 sum = _mm_setzero_ps();
+
+            for (int g = 0; g < numOverlaps; g++)
+                sum = _mm_add_ps(sum, _mm_mul_ps(loadSamples(grains[g] + i), _mm_loadu_ps(windows[g] + i)));
+
+            sum = _mm_mul_ps(sum, _mm_loadu_ps(normalisation + i));
+            _mm_storeu_ps(dest + i, accumulate ? _mm_add_ps(_mm_loadu_ps(dest + i), sum) : sum);
+        }
+       #elif AUTOFREEZE_OVERLAP_ADD_NEON
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            float32x4_t sum = vdupq_n_f32(0.0f);
+
+            for (int g = 0; g < numOverlaps; g++)
+                sum = vmlaq_f32(sum, loadSamples(grains[g] + i), vld1q_f32(windows[g] + i));
+
+            sum = vmulq_f32(sum, vld1q_f32(normalisation + i));
+            vst1q_f32(dest + i, accumulate ? vaddq_f32(vld1q_f32(dest + i), sum) : sum);
+        }
+       #endif
+
+        for (; i < numSamples; i++)
+        {
+            float sum = 0.0f;
+
+            for (int g = 0; g < numOverlaps; g++)
+                sum += loadSample(grains[g][i]) * windows[g][i];
+
+            dest[i] = accumulate ? dest[i] + sum * normalisation[i] : sum * normalisation[i];
+        }
+    }
+
+    template <int numOverlaps, typename Sample>
+    void overlapAdd (float* dest, const Sample* const* grains, const float* const* windows, const float* normalisation, int numSamples, bool accumulate)
+    {
+        if (accumulate)
+            overlapAdd<numOverlaps, true>(dest, grains, windows, normalisation, numSamples);
+        else
+            overlapAdd<numOverlaps, false>(dest, grains, windows, normalisation, numSamples);
+    }
+}
+
+const char* getStateName (AutoFreezeState state)
+{
+    switch (state) {
+        case AutoFreezeState::BelowThreshold: return "Below Threshold";
+        case AutoFreezeState::Predelay:       return "Predelay";
+        case AutoFreezeState::ReadingFreeze:  return "Reading Freeze";
+        case AutoFreezeState::Cooldown:       return "Cooldown";
+    }
+
+    return "";
+}
+
+//==============================================================================
+AutoFreezeEngine::AutoFreezeEngine()
+{
+    telemetry.reset(telemetryCapacity);
+
+    for (int order = minFreezeOrder; order <= largestFreezeOrder; order++)
+        freezeSizes.push_back(std::make_unique<FreezeSize>(order));
+
+    selectFreezeSize(defaultFreezeOrder);
+}
+
+AutoFreezeEngine::~AutoFreezeEngine()
+{
+    stopParallelCapture();
+    snapshotBank.close();
+}
+
+void AutoFreezeEngine::prepare (double newSampleRate, int maximumBlockSize, int numChannels)
+{
+    // a parallel capture still running uses the buffers below
+    stopParallelCapture();
+
+    sampleRate = newSampleRate;
+
+    // levels
+    inputLevels.prepare(sampleRate, numChannels, levelAttackSeconds, levelReleaseSeconds);
+    outputLevels.prepare(sampleRate, numChannels, levelAttackSeconds, levelReleaseSeconds);
+
+    // telemetry
+    blockIndex = 0;
+    numOverruns = 0;
+    maxProcessingSeconds = 0.0f;
+
+    // freeze sizes, up to the largest asked for, a compact engine drops the
+    // ones it doesn't need
+    const bool compact = compactMemory;
+    largestFreezeOrder = compact ? std::min(requestedLargestFreezeOrder.load(), compactMaxFreezeOrder)
+                                 : requestedLargestFreezeOrder.load();
+    const int largestSamples = 1 << largestFreezeOrder;
+    const int largestNumBins = largestSamples / 2 + 1;
+    const auto grainFormat = compact ? GrainBuffer::Format::Float16 : GrainBuffer::Format::Float32;
+    const int numSpare = compact ? compactNumSpareGrains : numSpareGrains;
+
+    // a compact engine leaves out what the features it's prepared with don't use
+    hasGrains = ! compact || synthesis != Synthesis::Streaming;
+    hasMorphBuffers = ! compact || morphSeconds > 0.0f;
+    const float lookbackSeconds = compact ? captureLookbackSeconds.load() : maxCaptureLookbackSeconds;
+
+    // the smallest size is never dropped, so freezeSize stays valid until
+    // the requested one is selected again below
+    freezeSize = freezeSizes.front().get();
+    freezeSizes.resize(static_cast<size_t>(largestFreezeOrder - minFreezeOrder + 1));
+
+    for (size_t i = 0; i < freezeSizes.size(); i++) {
+        if (freezeSizes[i] == nullptr)
+            freezeSizes[i] = std::make_unique<FreezeSize>(minFreezeOrder + static_cast<int>(i));
+    }
+
+    // freeze buffer
+    maxLookbackSamples = static_cast<int>(std::ceil(lookbackSeconds * sampleRate));
+    freezeBuffer.setSize(numChannels, largestSamples + maxLookbackSamples);
+
+    // grains
+    freezeMags.setSize(numChannels, largestNumBins);
+    grainPhases.prepare(hasGrains ? largestSamples / 2 : 0);
+
+    // layers, as many as were asked for that fit in the budget
+    const std::size_t grainBytes = hasGrains ? GrainPool::getMemoryUsage(numChannels, largestFreezeOrder, numGrains, numSpare, grainFormat) : 0;
+    const std::size_t layerBytes = std::max<std::size_t>(1, grainBytes);
+    const int numLayers = static_cast<int>(std::clamp<std::size_t>(std::min<std::size_t>(requestedNumLayers, layerMemoryBudget / layerBytes), 1, maxNumLayers));
+
+    // the worker reads every layer's grains, so it stops while they change
+    grainWorker.stop();
+
+    if (static_cast<int>(layers.size()) != numLayers) {
+        layers.clear();
+
+        for (int i = 0; i < numLayers; i++)
+            layers.push_back(std::make_unique<FreezeLayer>());
+
+        if (hasDeterministicSeed)
+            setDeterministicSeed(deterministicSeed);
+    }
+
+    // streaming always uses frames of the smallest size
+    const FreezeSize& frameSize = *freezeSizes.front();
+
+    std::vector<GrainPool*> grainPools;
+
+    for (auto& layer : layers) {
+        if (hasGrains) {
+            layer->grains.prepare(grainWorker, numChannels, minFreezeOrder, largestFreezeOrder, numGrains, numSpare, grainFormat);
+            grainPools.push_back(&layer->grains);
+        }
+
+        layer->stream.prepare(numChannels, *frameSize.fft, frameSize.window, frameSize.normalisation);
+        layer->stream.setSeed(layer->grains.getSeed());
+    }
+
+    if (hasGrains)
+        grainWorker.start(grainPools, largestFreezeOrder);
+    else
+        activeSynthesis = Synthesis::Streaming;
+
+    // capture
+    for (auto& size : freezeSizes)
+        size->prepare(sampleRate, numChannels);
+
+    captureEnergies.resize(numChannels + 1);
+    captureGains.resize(numChannels);
+
+    // morphing
+    const int numMorphChannels = hasMorphBuffers ? numChannels : 0;
+    morphSource.setSize(numMorphChannels, hasMorphBuffers ? largestNumBins : 0);
+    morphStep.setSize(numMorphChannels, hasMorphBuffers ? largestNumBins : 0);
+    morphSourceGains.resize(numChannels);
+    morphStepGains.resize(numChannels);
+
+    // saved freeze
+    savedFreeze.setSize(numChannels, largestNumBins);
+    savedFreezeStatus = savedFreezeIdle;
+
+    // spectrum view
+    const float maxViewFrequency = static_cast<float>(sampleRate / 2.0);
+    const float viewFrequencyRatio = std::max(1.0f, maxViewFrequency / AutoFreezeSpectrumView::minFrequency);
+
+    for (size_t point = 0; point < spectrumViewEdges.size(); point++)
+        spectrumViewEdges[point] = std::pow(viewFrequencyRatio, static_cast<float>(point) / AutoFreezeSpectrumView::numPoints) / viewFrequencyRatio;
+
+    for (auto& view : spectrumViews)
+        view = AutoFreezeSpectrumView();
+
+    spectrumViewExchange = 1;
+    spectrumViewBackIndex = 2;
+    spectrumViewFrontIndex = 0;
+
+    // parallel capture
+    parallelCapture = numChannels >= parallelChannelThreshold;
+    spectralWorkerScratch.clear();
+
+    if (parallelCapture)
+    {
+        const int numWorkers = std::clamp(static_cast<int>(std::thread::hardware_concurrency()) - 1, 1, maxSpectralWorkers);
+        spectralWorkerScratch.assign(numWorkers, std::vector<float>(2 * largestSamples));
+
+        for (auto& phases : parallelGrainPhases)
+            phases.prepare(largestSamples / 2);
+
+        spectralWorkers.prepare(numWorkers);
+    }
+
+    // scratch, sized here so that process never allocates
+    fftScratch.resize(2 * largestSamples);
+    freezeScratch.setSize(numChannels, maximumBlockSize);
+
+    // fades, every table can hold the longest fade
+    const int maxFadeLengths[] = { secondsToSamples(maxShortFadeSeconds, sampleRate),
+                                   secondsToSamples(maxLongFadeSeconds, sampleRate) };
+    const int fadeLengths[] = { secondsToSamples(shortFadeSeconds, sampleRate),
+                                secondsToSamples(longFadeSeconds, sampleRate) };
+    fadeTables.prepare(2, maxFadeLengths, fadeLengths);
+
+    // predelay & cooldown
+    updateParameters();
+
+    reset();
+}
+
+void AutoFreezeEngine::reset()
+{
+    currentState = AutoFreezeState::BelowThreshold;
+    dbLevel = gainToDecibels(0.0f);
+    inputLevels.reset();
+    outputLevels.reset();
+
+    freezeBuffer.clear();
+    freezeBufferIndex = 0;
+    freezeRingIndex = 0;
+    captureStartIndex = 0;
+
+    selectFreezeSize(requestedFreezeOrder);
+    freezeMags.clear();
+    captureMode = ChannelMode::Independent;
+    hasFreeze = false;
+    storeFreezeState();
+
+    for (auto& layer : layers)
+    {
+        publishToLayer(*layer, freezeMags, ChannelMode::Independent, nullptr);
+        layer->stream.reset();
+        layer->size = freezeSize;
+        layer->mode = ChannelMode::Independent;
+        layer->isActive = false;
+        layer->serial = 0;
+        layer->level = 0.0f;
+
+        for (int i = 0; i < numGrains; i++)
+        {
+            if (hasGrains)
+                layer->grains.getActiveGrain(i).clear();
+
+            layer->grainIndices[i] = freezeBufferSamples / 4 * i;
+        }
+    }
+
+    captureLayer = layers.empty() ? nullptr : layers.front().get();
+    layerSerial = 0;
+
+    morphCapture = false;
+    morphing = false;
+    morphPosition = 1.0f;
+
+    captureTaskIndex = 0;
+    captureUnit = 0;
+    captureCredit = 0;
+    captureSamplesLeft = 0;
+    parallelCaptureStage = 0;
+
+    predelayCounter = 0;
+    coolDownCounter = 0;
+    shortFadeIndex = 0;
+    longFadeIndex = 0;
+    shortFade = fadeTables.acquire(shortFadeTable);
+    longFade = fadeTables.acquire(longFadeTable);
+}
+
+void AutoFreezeEngine::release()
+{
+    stopParallelCapture();
+    grainWorker.stop();
+
+    freezeBuffer.setSize(0, 0);
+    fadeTables.release();
+}
+
+//==============================================================================
+void AutoFreezeEngine::process (float* const* channels, int numChannels, int numSamples)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+    updateParameters();
+
+    numChannels = std::min(numChannels, getNumChannels());
+    SampleBlock wholeBlock(channels, numChannels, 0, numSamples);
+    inputLevels.process(wholeBlock);
+
+    // a restored freeze can take over from anything but a capture
+    int expectedStatus = restoreReady;
+
+    if (currentState != AutoFreezeState::ReadingFreeze
+        && restoreStatus.compare_exchange_strong(expectedStatus, restoreTaking)) {
+        takeRestoredFreezeState();
+        restoreStatus = restoreEmpty;
+    }
+
+    // a store that getFreezeState held up, once freezeMags is whole
+    if (savedFreezePending && currentState != AutoFreezeState::ReadingFreeze)
+        storeFreezeState();
+
+    // streams start again from their first frame, and grains pick up
+    // where they were left
+    if (synthesis != activeSynthesis && hasGrains) {
+        activeSynthesis = synthesis;
+
+        for (auto& layer : layers)
+            layer->stream.reset();
+    }
+
+    const int renewalsBefore = getNumGrainRenewals();
+
+    // a host may exceed the block size it promised, so work through the
+    // buffer in pieces that the scratch buffers can hold
+    const int maxBlockSize = getMaximumBlockSize();
+
+    for (int start = 0; start < numSamples; start += maxBlockSize)
+    {
+        SampleBlock block(channels, numChannels, start, std::min(maxBlockSize, numSamples - start));
+        processSubBlock(block);
+    }
+
+    outputLevels.process(wholeBlock);
+
+    // a capture or morph in progress will be heard, whatever is playing now
+    idle = currentState == AutoFreezeState::BelowThreshold && ! morphing
+        && std::none_of(layers.begin(), layers.end(), [](const auto& layer) { return layer->isActive && layer->isAudible; });
+    const auto& output = outputLevels.getAverageLevels();
+    dbLevel = gainToDecibels(output.envelope);
+
+    // telemetry
+    const float processingSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+    const float budgetSeconds = static_cast<float>(numSamples / sampleRate);
+
+    if (processingSeconds > budgetSeconds)
+        numOverruns++;
+
+    if (processingSeconds > maxProcessingSeconds)
+        maxProcessingSeconds = processingSeconds;
+
+    AutoFreezeTelemetry frame;
+    frame.blockIndex = blockIndex++;
+    frame.state = currentState;
+    frame.numSamples = numSamples;
+    frame.inputRms = inputLevels.getAverageLevels().rms;
+    frame.outputRms = output.rms;
+    frame.outputPeak = output.peak;
+    frame.outputEnvelope = output.envelope;
+    frame.processingSeconds = processingSeconds;
+    frame.budgetSeconds = budgetSeconds;
+    frame.grainRenewals = getNumGrainRenewals() - renewalsBefore;
+    frame.activeLayers = static_cast<int>(std::count_if(layers.begin(), layers.end(), [](const auto& layer) { return layer->isActive; }));
+    frame.idle = idle;
+    frame.grainUnderruns = getNumGrainUnderruns();
+    frame.overruns = numOverruns;
+    frame.maxProcessingSeconds = maxProcessingSeconds;
+    telemetry.push(frame);
+}
+
+void AutoFreezeEngine::updateParameters()
+{
+    predelaySamples = secondsToSamples(predelaySeconds, sampleRate);
+    cooldownSamples = secondsToSamples(cooldownSeconds, sampleRate);
+
+    // only rebuilt in the background if the length has really changed
+    fadeTables.setLength(shortFadeTable, secondsToSamples(shortFadeSeconds, sampleRate));
+    fadeTables.setLength(longFadeTable, secondsToSamples(longFadeSeconds, sampleRate));
+}
+
+void AutoFreezeEngine::processSubBlock (SampleBlock& buffer)
+{
+    // the block is split wherever a state runs out, so every transition
+    // lands on its exact sample whatever the block size
+    for (int start = 0; start < buffer.getNumSamples();)
+    {
+        // one state can hand straight over to the next on the same sample
+        for (auto previousState = currentState;; previousState = currentState) {
+            updateState();
+
+            if (currentState == previousState)
+                break;
+        }
+
+        SampleBlock run = buffer.getSubBlock(start, getNumSamplesUntilTransition(buffer.getNumSamples() - start));
+
+        // the ring is left alone while a capture is being analysed from it
+        if (rollingCapture && currentState != AutoFreezeState::ReadingFreeze)
+            writeToRing(run);
+
+        switch (currentState) {
+            case AutoFreezeState::BelowThreshold:
+                processBelowThreshold(run);
+                break;
+            case AutoFreezeState::Predelay:
+                processPredelay(run);
+                break;
+            case AutoFreezeState::ReadingFreeze:
+                processReadingFreeze(run);
+                break;
+            case AutoFreezeState::Cooldown:
+                processCooldown(run);
+                break;
+        }
+
+        if (morphing)
+            advanceMorph(run.getNumSamples());
+
+        start += run.getNumSamples();
+    }
+}
+
+int AutoFreezeEngine::getNumSamplesUntilTransition (int numSamplesAvailable) const
+{
+    int numSamples = numSamplesAvailable;
+
+    // the level and the capture are checked once per run, the counters are exact
+    switch (currentState) {
+        case AutoFreezeState::BelowThreshold:
+            break;
+        case AutoFreezeState::Predelay:
+            numSamples = (rollingCapture ? shortFade.length : predelaySamples) - predelayCounter;
+            break;
+        case AutoFreezeState::ReadingFreeze:
+            if (freezeBufferIndex < freezeBufferSamples)
+                numSamples = freezeBufferSamples - freezeBufferIndex;
+            else if (! parallelCapture)
+                numSamples = captureSamplesLeft;
+            break;
+        case AutoFreezeState::Cooldown:
+            numSamples = cooldownSamples - coolDownCounter;
+            break;
+    }
+
+    // a morph step is published on its exact sample too
+    if (morphing)
+        numSamples = std::min(numSamples, morphSamplesLeft);
+
+    return std::clamp(numSamples, 1, numSamplesAvailable);
+}
+
+void AutoFreezeEngine::writeToRing (const SampleBlock& buffer)
+{
+    const int ringSamples = freezeBuffer.getNumSamples();
+    int remaining = buffer.getNumSamples();
+    int source = 0;
+
+    // a block can be longer than the ring if the host sends huge blocks
+    if (remaining > ringSamples)
+    {
+        source = remaining - ringSamples;
+        remaining = ringSamples;
+    }
+
+    while (remaining > 0)
+    {
+        const int numSamples = std::min(remaining, ringSamples - freezeRingIndex);
+
+        for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+            freezeBuffer.copyFrom(channel, freezeRingIndex, buffer.getReadPointer(channel) + source, numSamples);
+
+        freezeRingIndex = (freezeRingIndex + numSamples) % ringSamples;
+        source += numSamples;
+        remaining -= numSamples;
+    }
+}
+
+void AutoFreezeEngine::setCaptureLookbackSeconds (float lookbackSeconds)
+{
+    captureLookbackSeconds = std::clamp(lookbackSeconds, 0.0f, maxCaptureLookbackSeconds);
+}
+
+void AutoFreezeEngine::setFreezeOrder (int newOrder)
+{
+    requestedFreezeOrder = std::clamp(newOrder, minFreezeOrder, maxFreezeOrder);
+}
+
+// each layer has its own seed, so layers captured from the same sound differ
+void AutoFreezeEngine::setDeterministicSeed (std::uint64_t seed)
+{
+    deterministicSeed = seed;
+    hasDeterministicSeed = true;
+
+    for (size_t i = 0; i < layers.size(); i++) {
+        layers[i]->grains.setSeed(seed + i);
+        layers[i]->stream.setSeed(seed + i);
+    }
+}
+
+int AutoFreezeEngine::getNumGrainUnderruns() const
+{
+    int numUnderruns = 0;
+
+    for (auto& layer : layers)
+        numUnderruns += layer->grains.getNumUnderruns();
+
+    return numUnderruns;
+}
+
+int AutoFreezeEngine::getNumGrainRenewals() const
+{
+    int numRenewals = 0;
+
+    for (auto& layer : layers)
+        numRenewals += layer->grains.getNumRenewals();
+
+    return numRenewals;
+}
+
+void AutoFreezeEngine::setThresholdDb (float newThresholdDb)
+{
+    thresholdDb = std::clamp(newThresholdDb, minThresholdDb, maxThresholdDb);
+}
+
+void AutoFreezeEngine::setPredelaySeconds (float newSeconds)
+{
+    predelaySeconds = std::clamp(newSeconds, 0.0f, maxPredelaySeconds);
+}
+
+void AutoFreezeEngine::setCooldownSeconds (float newSeconds)
+{
+    cooldownSeconds = std::clamp(newSeconds, minCooldownSeconds, maxCooldownSeconds);
+}
+
+void AutoFreezeEngine::setShortFadeSeconds (float newSeconds)
+{
+    shortFadeSeconds = std::clamp(newSeconds, minFadeSeconds, maxShortFadeSeconds);
+}
+
+void AutoFreezeEngine::setLongFadeSeconds (float newSeconds)
+{
+    longFadeSeconds = std::clamp(newSeconds, minFadeSeconds, maxLongFadeSeconds);
+}
+
+void AutoFreezeEngine::setMorphSeconds (float newSeconds)
+{
+    morphSeconds = std::clamp(newSeconds, 0.0f, maxMorphSeconds);
+}
+
+void AutoFreezeEngine::selectFreezeSize (int order)
+{
+    order = std::min(order, largestFreezeOrder.load());
+    freezeSize = freezeSizes[static_cast<size_t>(order - minFreezeOrder)].get();
+    freezeBufferSamples = freezeSize->numSamples;
+
+    // the phase tables were prepared for the largest size
+    grainPhases.setNumBins(freezeBufferSamples / 2);
+
+    for (auto& phases : parallelGrainPhases)
+        phases.setNumBins(freezeBufferSamples / 2);
+}
+
+//==============================================================================
+AutoFreezeEngine::FreezeSize::FreezeSize (int sizeOrder)
+    : order(sizeOrder), numSamples(1 << sizeOrder),
+      fft(SharedTables::getFft(sizeOrder)), pairFft(SharedTables::getFft(sizeOrder + 1)),
+      windows(SharedTables::getWindow(numSamples, numGrains)),
+      window(windows->window.data()), normalisation(windows->normalisation.data())
+{
+}
+
+void AutoFreezeEngine::FreezeSize::prepare (double sampleRate, int numChannels)
+{
+    const auto captureSpreadSamples = std::max<std::int64_t>(1, std::llround(captureSpreadSeconds * sampleRate));
+
+    for (int mode = 0; mode < numChannelModes; mode++)
+    {
+        buildCaptureTasks(static_cast<ChannelMode>(mode), numChannels);
+
+        std::int64_t captureUnits = 0;
+
+        for (const auto& task : captureTasks[mode])
+            captureUnits += getNumUnits(task);
+
+        captureUnitsPerSample[mode] = (captureUnits + captureSpreadSamples - 1) / captureSpreadSamples;
+        captureSamples[mode] = static_cast<int>((captureUnits + captureUnitsPerSample[mode] - 1) / captureUnitsPerSample[mode]);
+    }
+}
+
+void AutoFreezeEngine::FreezeSize::buildCaptureTasks(ChannelMode mode, int numChannels)
+{
+    auto& tasks = captureTasks[static_cast<size_t>(mode)];
+    auto& slots = captureSlots[static_cast<size_t>(mode)];
+    tasks.clear();
+    slots.clear();
+
+    // a slot is a channel on its own, a pair starting at that channel, or
+    // with shared magnitudes the mid signal of every channel
+    for (int channel = 0; channel < numChannels; channel++)
+    {
+        if (mode == ChannelMode::MidSide && channel > 0)
+            break;
+
+        slots.push_back(channel);
+
+        if (mode == ChannelMode::LinkedStereo && channel + 1 < numChannels)
+            channel++;
+    }
+
+    const auto isPair = [&](int slot) { return mode == ChannelMode::LinkedStereo && slot + 1 < numChannels; };
+
+    // analysis
+    for (int slot : slots)
+    {
+        if (isPair(slot))
+        {
+            tasks.push_back({ CaptureTaskType::WindowPair, slot, -1, 0 });
+
+            for (int pass = 0; pass < pairFft->getNumComplexPasses(); pass++)
+                tasks.push_back({ CaptureTaskType::ComplexForwardPass, slot, -1, pass });
+
+            tasks.push_back({ CaptureTaskType::StorePairMagnitudes, slot, -1, 0 });
+            continue;
+        }
+
+        tasks.push_back({ mode == ChannelMode::MidSide ? CaptureTaskType::WindowShared : CaptureTaskType::Window, slot, -1, 0 });
+
+        for (int pass = 0; pass < fft->getNumForwardPasses(); pass++)
+            tasks.push_back({ CaptureTaskType::ForwardPass, slot, -1, pass });
+
+        tasks.push_back({ CaptureTaskType::StoreMagnitudes, slot, -1, 0 });
+    }
+
+    tasks.push_back({ CaptureTaskType::PublishSpectrum, -1, -1, 0 });
+
+    // resynthesis
+    for (int grain = 0; grain < numGrains; grain++)
+    {
+        tasks.push_back({ CaptureTaskType::RandomisePhases, -1, grain, 0 });
+
+        for (int slot : slots)
+        {
+            if (isPair(slot))
+            {
+                tasks.push_back({ CaptureTaskType::PairToCartesian, slot, grain, 0 });
+
+                for (int pass = 0; pass < pairFft->getNumComplexPasses(); pass++)
+                    tasks.push_back({ CaptureTaskType::ComplexInversePass, slot, grain, pass });
+
+                tasks.push_back({ CaptureTaskType::StorePairGrain, slot, grain, 0 });
+                continue;
+            }
+
+            tasks.push_back({ CaptureTaskType::ToCartesian, slot, grain, 0 });
+
+            for (int pass = 0; pass < fft->getNumInversePasses(); pass++)
+                tasks.push_back({ CaptureTaskType::InversePass, slot, grain, pass });
+
+            tasks.push_back({ mode == ChannelMode::MidSide ? CaptureTaskType::StoreSharedGrain : CaptureTaskType::StoreGrain, slot, grain, 0 });
+        }
+    }
+}
+
+int AutoFreezeEngine::FreezeSize::getNumUnits(const CaptureTask& task) const
+{
+    switch (task.type) {
+        case CaptureTaskType::WindowPair:
+        case CaptureTaskType::ComplexForwardPass:
+        case CaptureTaskType::StorePairMagnitudes:
+        case CaptureTaskType::PairToCartesian:
+        case CaptureTaskType::ComplexInversePass:
+        case CaptureTaskType::StorePairGrain:
+            return pairFft->getPassLength();
+        default:
+            return fft->getPassLength();
+    }
+}
+
+//==============================================================================
+
+void AutoFreezeEngine::publishCapturedSpectrum()
+{
+    if (captureMode == ChannelMode::MidSide)
+    {
+        // each channel keeps its own level on top of the mid magnitudes
+        const double midEnergy = captureEnergies.back();
+
+        for (size_t channel = 0; channel < captureGains.size(); channel++)
+            captureGains[channel] = midEnergy > 0.0 ? static_cast<float>(std::sqrt(captureEnergies[channel] / midEnergy)) : 1.0f;
+    }
+
+    // a morph publishes its steps once the capture has finished
+    if (! morphCapture)
+        publishToLayer(*captureLayer, freezeMags, captureMode, captureGains.data());
+
+    hasFreeze = true;
+    storeFreezeState();
+}
+
+void AutoFreezeEngine::storeFreezeState()
+{
+    int expectedStatus = savedFreezeIdle;
+    savedFreezePending = ! savedFreezeStatus.compare_exchange_strong(expectedStatus, savedFreezeStoring);
+
+    if (savedFreezePending)
+        return;
+
+    if (hasFreeze)
+        savedFreeze.copyFrom(freezeMags, freezeSize->order, captureMode, captureGains.data());
+    else
+        savedFreeze.clear();
+
+    savedFreezeStatus = savedFreezeIdle;
+}
+
+void AutoFreezeEngine::takeRestoredFreezeState()
+{
+    // a restore replaces the newest layer, or takes one if none are playing
+    FreezeLayer* layer = getNewestLayer();
+
+    if (layer == nullptr)
+        layer = &takeLayer();
+
+    // a freeze larger than the engine was prepared for plays at the largest
+    // size it was, checked here since a prepare can come after the restore
+    const int order = std::min(restoredFreeze.getFftOrder(), largestFreezeOrder.load());
+    const bool sizeChanged = ! layer->isActive || order != layer->size->order;
+    selectFreezeSize(order);
+
+    // one of the same size and channel mode morphs the layer from what it's
+    // playing, even partway through a morph, like a capture would
+    const bool morphRestore = hasMorphBuffers && ! sizeChanged && layer->mode == restoredFreeze.getMode();
+
+    if (morphRestore) {
+        captureLayer = layer;
+        startMorphCapture();
+    }
+
+    captureMode = restoredFreeze.getMode();
+
+    // a freeze saved with fewer channels repeats its last one
+    const int numChannels = freezeMags.getNumChannels();
+    const int numMagnitudeChannels = captureMode == ChannelMode::MidSide ? 1 : numChannels;
+    const int numBins = std::min(freezeBufferSamples / 2 + 1, freezeMags.getNumSamples());
+    const int restoredBins = restoredFreeze.getNumBins();
+    const int ratio = 1 << (restoredFreeze.getFftOrder() - freezeSize->order);
+
+    for (int channel = 0; channel < numMagnitudeChannels; channel++) {
+        const int sourceChannel = std::min(channel, restoredFreeze.getNumMagnitudeChannels() - 1);
+        const float* source = restoredFreeze.getMagnitudes(sourceChannel);
+
+        if (ratio == 1) {
+            freezeMags.copyFrom(channel, 0, source, std::min(numBins, restoredBins));
+            continue;
+        }
+
+        // the power of the bins around each one, scaled to the smaller FFT
+        float* dest = freezeMags.getWritePointer(channel);
+
+        for (int bin = 0; bin < numBins; bin++) {
+            const int begin = std::max(0, bin * ratio - ratio / 2);
+            const int end = std::min(restoredBins, bin * ratio + (ratio + 1) / 2);
+            float power = 0.0f;
+
+            for (int restoredBin = begin; restoredBin < end; restoredBin++)
+                power += source[restoredBin] * source[restoredBin];
+
+            dest[bin] = std::sqrt(power) / static_cast<float>(ratio);
+        }
+    }
+
+    for (int channel = 0; channel < numChannels; channel++)
+        captureGains[channel] = restoredFreeze.getGain(std::min(channel, restoredFreeze.getNumChannels() - 1));
+
+    hasFreeze = true;
+    storeFreezeState();
+
+    // over morphSeconds, or the long fade without a morph time, and the
+    // morph publishes its steps to the layer
+    if (morphRestore) {
+        const float seconds = morphSeconds;
+        startMorph(seconds > 0.0f ? seconds : longFadeSeconds.load());
+        layer->serial = ++layerSerial;
+        return;
+    }
+
+    publishToLayer(*layer, freezeMags, captureMode, captureGains.data());
+
+    // a new size or channel mode means starting the grains again
+    if (sizeChanged) {
+        const int hop = freezeBufferSamples / numGrains;
+
+        for (int i = 0; i < numGrains; i++)
+            layer->grainIndices[i] = hop * (numGrains - 1 - i);
+    }
+
+    if (! layer->isActive)
+        layer->stream.reset();
+
+    layer->size = freezeSize;
+    layer->mode = captureMode;
+    layer->isActive = true;
+    layer->serial = ++layerSerial;
+
+    morphing = false;
+    morphPosition = 1.0f;
+}
+
+bool AutoFreezeEngine::getFreezeState (std::vector<std::uint8_t>& destData, FreezeState::Encoding encoding)
+{
+    // the audio thread never waits for this, but this waits for it to
+    // finish a store
+    for (int expected = savedFreezeIdle; ! savedFreezeStatus.compare_exchange_weak(expected, savedFreezeReading); expected = savedFreezeIdle)
+        std::this_thread::yield();
+
+    const bool hasState = ! savedFreeze.isEmpty();
+
+    if (hasState)
+        savedFreeze.toBinary(encoding, destData);
+
+    savedFreezeStatus = savedFreezeIdle;
+    return hasState;
+}
+
+bool AutoFreezeEngine::setSnapshotBank (const void* data, std::size_t numBytes)
+{
+    if (data == nullptr) {
+        snapshotBank.close();
+        return true;
+    }
+
+    return snapshotBank.open(data, numBytes, [this](const void* snapshotData, std::size_t snapshotBytes) {
+        restoreFreezeState(snapshotData, snapshotBytes);
+    });
+}
+
+void AutoFreezeEngine::setSnapshotParameter (int snapshot, bool shouldRecall)
+{
+    // 0 leaves the freeze alone, so only a change to a snapshot recalls one
+    if (snapshot != lastSnapshotParameter.exchange(snapshot) && snapshot > 0 && shouldRecall)
+        recallSnapshot(snapshot - 1);
+}
+
+void AutoFreezeEngine::handleMidiMessage (const std::uint8_t* data, int numBytes)
+{
+    if (numBytes < 2)
+        return;
+
+    const int status = data[0] & 0xf0;
+
+    if (status == 0xb0 && numBytes >= 3 && data[1] == 0)
+        midiSnapshotBank = data[2] & 0x7f;
+    else if (status == 0xc0)
+        recallSnapshot(midiSnapshotBank * 128 + (data[1] & 0x7f));
+}
+
+bool AutoFreezeEngine::restoreFreezeState (const void* data, std::size_t numBytes)
+{
+    // the audio thread never waits for this, but this waits for it to finish
+    // taking up the previous restore
+    for (int expected = restoreEmpty;; expected = restoreEmpty) {
+        if (restoreStatus.compare_exchange_weak(expected, restoreWriting))
+            break;
+
+        expected = restoreReady;
+
+        if (restoreStatus.compare_exchange_weak(expected, restoreWriting))
+            break;
+
+        std::this_thread::yield();
+    }
+
+    const bool isValid = restoredFreeze.fromBinary(data, numBytes)
+                      && restoredFreeze.getFftOrder() >= minFreezeOrder
+                      && restoredFreeze.getFftOrder() <= maxFreezeOrder;
+
+    restoreStatus = isValid ? restoreReady : restoreEmpty;
+    return isValid;
+}
+
+void AutoFreezeEngine::runCaptureTask(const CaptureTask& task, int beginUnit, int endUnit, float* scratch, RandomPhaseSpectrum& phases)
+{
+    const int numUnits = freezeSize->getNumUnits(task);
+    const int numBins = freezeBufferSamples / 2 + 1;
+    const int ringSamples = freezeBuffer.getNumSamples();
+
+    // a morph leaves the playing grains alone, they're renewed from its
+    // steps, and an engine without grains only analyses
+    if ((morphCapture || ! hasGrains) && task.grain >= 0)
+        return;
+
+    const auto ringIndex = [&](int sample) {
+        const int index = captureStartIndex + sample;
+        return index >= ringSamples ? index - ringSamples : index;
+    };
+
+    switch (task.type) {
+        case CaptureTaskType::Window: {
+            const float* channelFreezeData = freezeBuffer.getReadPointer(task.channel);
+            const int end = unitToIndex(endUnit, numUnits, freezeBufferSamples);
+
+            for (int sample = unitToIndex(beginUnit, numUnits, freezeBufferSamples); sample < end; sample++)
+                scratch[sample] = channelFreezeData[ringIndex(sample)] * freezeSize->window[sample];
+
+            break;
+        }
+        case CaptureTaskType::ForwardPass:
+            freezeSize->fft->performForwardPass(scratch, task.pass, beginUnit, endUnit);
+            break;
+        case CaptureTaskType::StoreMagnitudes: {
+            // only the bins up to Nyquist are ever resynthesised
+            const int begin = unitToIndex(beginUnit, numUnits, numBins);
+            const int end = unitToIndex(endUnit, numUnits, numBins);
+            freezeMags.copyFrom(task.channel, begin, scratch + begin, end - begin);
+            break;
+        }
+        case CaptureTaskType::PublishSpectrum:
+            publishCapturedSpectrum();
+            break;
+        case CaptureTaskType::RandomisePhases:
+            phases.randomise(captureLayer->grains.getSeed(), captureLayer->grains.getGeneration(), static_cast<std::uint64_t>(task.grain));
+            break;
+        case CaptureTaskType::ToCartesian:
+            phases.toCartesian(freezeMags.getReadPointer(task.channel), scratch);
+            break;
+        case CaptureTaskType::InversePass:
+            freezeSize->fft->performInversePass(scratch, task.pass, beginUnit, endUnit);
+            break;
+        case CaptureTaskType::StoreGrain: {
+            const int begin = unitToIndex(beginUnit, numUnits, freezeBufferSamples);
+            const int end = unitToIndex(endUnit, numUnits, freezeBufferSamples);
+            captureLayer->grains.getActiveGrain(task.grain).write(task.channel, begin, scratch + begin, end - begin);
+            break;
+        }
+        case CaptureTaskType::WindowPair: {
+            // channel A in the real parts and channel B in the imaginary parts
+            const float* dataA = freezeBuffer.getReadPointer(task.channel);
+            const float* dataB = freezeBuffer.getReadPointer(task.channel + 1);
+            const int end = unitToIndex(endUnit, numUnits, freezeBufferSamples);
+
+            for (int sample = unitToIndex(beginUnit, numUnits, freezeBufferSamples); sample < end; sample++) {
+                const int index = ringIndex(sample);
+                scratch[2 * sample] = dataA[index] * freezeSize->window[sample];
+                scratch[2 * sample + 1] = dataB[index] * freezeSize->window[sample];
+            }
+
+            break;
+        }
+        case CaptureTaskType::ComplexForwardPass:
+            freezeSize->pairFft->performComplexPass(scratch, false, task.pass, beginUnit, endUnit);
+            break;
+        case CaptureTaskType::StorePairMagnitudes: {
+            // A[k] = (Z[k] + conj Z[N - k]) / 2 and B[k] = (Z[k] - conj Z[N - k]) / 2i
+            float* magsA = freezeMags.getWritePointer(task.channel);
+            float* magsB = freezeMags.getWritePointer(task.channel + 1);
+            const int end = unitToIndex(endUnit, numUnits, numBins);
+
+            for (int bin = unitToIndex(beginUnit, numUnits, numBins); bin < end; bin++) {
+                const int mirror = bin == 0 ? 0 : freezeBufferSamples - bin;
+                const float zr = scratch[2 * bin];
+                const float zi = scratch[2 * bin + 1];
+                const float mr = scratch[2 * mirror];
+                const float mi = scratch[2 * mirror + 1];
+
+                magsA[bin] = 0.5f * std::hypot(zr + mr, zi - mi);
+                magsB[bin] = 0.5f * std::hypot(zr - mr, zi + mi);
+            }
+
+            break;
+        }
+        case CaptureTaskType::PairToCartesian:
+            phases.toCartesianPair(freezeMags.getReadPointer(task.channel), freezeMags.getReadPointer(task.channel + 1), scratch);
+            break;
+        case CaptureTaskType::ComplexInversePass:
+            freezeSize->pairFft->performComplexPass(scratch, true, task.pass, beginUnit, endUnit);
+            break;
+        case CaptureTaskType::StorePairGrain: {
+            auto& grain = captureLayer->grains.getActiveGrain(task.grain);
+            const float scale = 1.0f / static_cast<float>(freezeBufferSamples);
+            const int begin = unitToIndex(beginUnit, numUnits, freezeBufferSamples);
+            const int end = unitToIndex(endUnit, numUnits, freezeBufferSamples);
+
+            grain.write(task.channel, begin, scratch + 2 * begin, end - begin, scale, 2);
+            grain.write(task.channel + 1, begin, scratch + 2 * begin + 1, end - begin, scale, 2);
+            break;
+        }
+        case CaptureTaskType::WindowShared: {
+            // the mid signal, and the energies that set each channel's level
+            const int numChannels = freezeBuffer.getNumChannels();
+            const float midScale = 1.0f / static_cast<float>(numChannels);
+            const int end = unitToIndex(endUnit, numUnits, freezeBufferSamples);
+
+            if (beginUnit == 0)
+                std::fill(captureEnergies.begin(), captureEnergies.end(), 0.0);
+
+            for (int sample = unitToIndex(beginUnit, numUnits, freezeBufferSamples); sample < end; sample++) {
+                const int index = ringIndex(sample);
+                float mid = 0.0f;
+
+                for (int channel = 0; channel < numChannels; channel++) {
+                    const float value = freezeBuffer.getReadPointer(channel)[index];
+                    captureEnergies[channel] += value * value;
+                    mid += value;
+                }
+
+                mid *= midScale;
+                captureEnergies[numChannels] += mid * mid;
+                scratch[sample] = mid * freezeSize->window[sample];
+            }
+
+            break;
+        }
+        case CaptureTaskType::StoreSharedGrain: {
+            auto& grain = captureLayer->grains.getActiveGrain(task.grain);
+            const int begin = unitToIndex(beginUnit, numUnits, freezeBufferSamples);
+            const int end = unitToIndex(endUnit, numUnits, freezeBufferSamples);
+
+            for (int channel = 0; channel < grain.getNumChannels(); channel++)
+                grain.write(channel, begin, scratch + begin, end - begin, captureGains[channel]);
+
+            break;
+        }
+    }
+}
+
+// Once captureSamples have been given, the credit covers every unit, so the
+// capture is always finished by then and never before it's due.
+void AutoFreezeEngine::advanceCapture(int numSamples)
+{
+    const auto& tasks = getCaptureTasks();
+    captureCredit += numSamples * freezeSize->captureUnitsPerSample[static_cast<size_t>(captureMode)];
+    captureSamplesLeft -= numSamples;
+
+    while (captureTaskIndex < tasks.size())
+    {
+        if (captureCredit <= 0)
+            return;
+
+        const auto& task = tasks[captureTaskIndex];
+        const int numUnits = freezeSize->getNumUnits(task);
+
+        // phase and spectrum tasks can't be split, so they run whole and the
+        // next few blocks make up for it
+        const bool splittable = task.type != CaptureTaskType::PublishSpectrum
+                             && task.type != CaptureTaskType::RandomisePhases
+                             && task.type != CaptureTaskType::ToCartesian
+                             && task.type != CaptureTaskType::PairToCartesian;
+
+        const int endUnit = splittable ? static_cast<int>(std::min<std::int64_t>(numUnits, captureUnit + captureCredit))
+                                       : numUnits;
+
+        runCaptureTask(task, captureUnit, endUnit, fftScratch.data(), grainPhases);
+        captureCredit -= endUnit - captureUnit;
+        captureUnit = endUnit;
+
+        if (captureUnit == numUnits)
+        {
+            captureUnit = 0;
+            captureTaskIndex++;
+        }
+    }
+}
+
+void AutoFreezeEngine::runWholeCaptureTasks(int channel, int grain, float* scratch, RandomPhaseSpectrum& phases)
+{
+    for (const auto& task : getCaptureTasks())
+    {
+        if (task.channel == channel && task.grain == grain && task.type != CaptureTaskType::PublishSpectrum)
+            runCaptureTask(task, 0, freezeSize->getNumUnits(task), scratch, phases);
+    }
+}
+
+void AutoFreezeEngine::stopParallelCapture()
+{
+    spectralWorkers.release();
+    parallelCaptureStage = 0;
+}
+
+bool AutoFreezeEngine::advanceParallelCapture()
+{
+    while (spectralWorkers.isFinished())
+    {
+        if (parallelCaptureStage == numParallelCaptureStages)
+            return true;
+
+        parallelCaptureStage++;
+
+        const int numSlots = static_cast<int>(getCaptureSlots().size());
+        const int numItems = parallelCaptureStage == 1 ? numSlots
+                           : parallelCaptureStage == 2 ? 1
+                           : parallelCaptureStage == 3 ? numGrains
+                           : numGrains * numSlots;
+
+        spectralWorkers.start(&runParallelCaptureItem, this, numItems);
+
+        // offline renders wait, so the freeze always starts on the same block
+        if (! nonRealtime)
+            return false;
+
+        spectralWorkers.waitUntilFinished();
+    }
+
+    return false;
+}
+
+void AutoFreezeEngine::runParallelCaptureItem(void* context, int item, int threadIndex)
+{
+    auto& engine = *static_cast<AutoFreezeEngine*>(context);
+    float* scratch = engine.spectralWorkerScratch[threadIndex].data();
+    const auto& slots = engine.getCaptureSlots();
+    const int numSlots = static_cast<int>(slots.size());
+
+    switch (engine.parallelCaptureStage) {
+        case 1:
+            engine.runWholeCaptureTasks(slots[item], -1, scratch, engine.parallelGrainPhases[0]);
+            break;
+        case 2:
+            engine.publishCapturedSpectrum();
+            break;
+        case 3:
+            engine.runWholeCaptureTasks(-1, item, scratch, engine.parallelGrainPhases[item]);
+            break;
+        default: {
+            const int grain = item / numSlots;
+            engine.runWholeCaptureTasks(slots[item % numSlots], grain, scratch, engine.parallelGrainPhases[grain]);
+            break;
+        }
+    }
+}
+
+void AutoFreezeEngine::calculateFreezeMagnitudes()
+{
+    for (int slot : getCaptureSlots())
+        runWholeCaptureTasks(slot, -1, fftScratch.data(), grainPhases);
+}
+
+void AutoFreezeEngine::readIntoGrain(int grainNum)
+{
+    // this runs on the audio thread, so a grain that doesn't exist is ignored
+    if (grainNum < 0 || grainNum >= numGrains)
+        return;
+
+    runWholeCaptureTasks(-1, grainNum, fftScratch.data(), grainPhases);
+
+    for (int slot : getCaptureSlots())
+        runWholeCaptureTasks(slot, grainNum, fftScratch.data(), grainPhases);
+}
+
+void AutoFreezeEngine::updateState()
+{
+    switch(currentState)
+    {
+        case AutoFreezeState::BelowThreshold: {
+            float rms = inputLevels.getAverageLevels().rms;
+            float rmsDb = gainToDecibels(rms);
+
+            if (rmsDb > thresholdDb) {
+                currentState = AutoFreezeState::Predelay;
+                predelayCounter = 0;
+                shortFadeIndex = 0;
+                shortFade = fadeTables.acquire(shortFadeTable);
+            }
+
+            break;
+        }
+        case AutoFreezeState::Predelay: {
+            // a rolling capture only waits for the dry signal to fade in
+            if (predelayCounter >= (rollingCapture ? shortFade.length : predelaySamples)) {
+                currentState = AutoFreezeState::ReadingFreeze;
+                selectFreezeSize(requestedFreezeOrder);
+                freezeBufferIndex = 0;
+                captureStartIndex = 0;
+
+                if (rollingCapture) {
+                    // the ring already holds the window, so the capture starts straight away
+                    const int ringSamples = freezeBuffer.getNumSamples();
+                    const int lookbackSamples = std::min(maxLookbackSamples, static_cast<int>(captureLookbackSeconds * sampleRate));
+                    freezeBufferIndex = freezeBufferSamples;
+                    captureStartIndex = (freezeRingIndex - freezeBufferSamples - lookbackSamples + 2 * ringSamples) % ringSamples;
+                }
+
+                // the layer the capture goes to is out of the mix until it's
+                // finished, unless the capture is going to morph it
+                captureMode = channelMode;
+                FreezeLayer* newest = getNewestLayer();
+                morphCapture = morphSeconds > 0.0f && hasMorphBuffers && newest != nullptr
+                            && newest->size == freezeSize && newest->mode == captureMode;
+
+                if (morphCapture) {
+                    captureLayer = newest;
+                    startMorphCapture();
+                } else {
+                    captureLayer = &takeLayer();
+                    captureLayer->isActive = false;
+                    morphing = false;
+                    morphPosition = 1.0f;
+                }
+
+                captureTaskIndex = 0;
+                captureUnit = 0;
+                captureCredit = 0;
+                captureSamplesLeft = freezeSize->captureSamples[static_cast<size_t>(captureMode)];
+                parallelCaptureStage = 0;
+            }
+
+            break;
+        }
+        case AutoFreezeState::ReadingFreeze:
+            // the dry signal carries on until the capture has been resynthesised
+            if (freezeBufferIndex >= freezeBufferSamples
+                && (parallelCapture ? advanceParallelCapture() : captureSamplesLeft <= 0)) {
+                currentState = AutoFreezeState::Cooldown;
+                coolDownCounter = 0;
+                longFadeIndex = 0;
+                longFade = fadeTables.acquire(longFadeTable);
+
+                // the layer is as loud as the block the freeze takes over from
+                captureLayer->size = freezeSize;
+                captureLayer->mode = captureMode;
+                captureLayer->isActive = true;
+                captureLayer->serial = ++layerSerial;
+                captureLayer->level = inputLevels.getAverageLevels().rms;
+
+                // a morphed layer carries on from where its grains are
+                if (morphCapture) {
+                    startMorph(morphSeconds);
+                } else {
+                    for (int i = 0; i < numGrains; i ++) {
+                        captureLayer->grainIndices[i] = freezeBufferSamples / numGrains * i;
+                    }
+
+                    captureLayer->stream.reset();
+                }
+            }
+
+            break;
+        case AutoFreezeState::Cooldown:
+            if (coolDownCounter >= cooldownSamples) {
+                currentState = AutoFreezeState::BelowThreshold;
+            }
+
+            break;
+    }
+}
+
+void AutoFreezeEngine::startMorphCapture()
+{
+    // the morph starts from what the layer is playing, which is partway to
+    // freezeMags if it's still morphing to the previous capture
+    const int numBins = freezeBufferSamples / 2 + 1;
+    const int numChannels = freezeMags.getNumChannels();
+    const int numMagnitudeChannels = captureMode == ChannelMode::MidSide ? 1 : numChannels;
+
+    for (int channel = 0; channel < numMagnitudeChannels; channel++) {
+        if (morphPosition >= 1.0f)
+            morphSource.copyFrom(channel, 0, freezeMags.getReadPointer(channel), numBins);
+        else
+            interpolate(morphSource.getWritePointer(channel), morphSource.getReadPointer(channel),
+                        freezeMags.getReadPointer(channel), morphPosition, numBins);
+    }
+
+    if (morphPosition >= 1.0f)
+        std::copy(captureGains.begin(), captureGains.end(), morphSourceGains.begin());
+    else
+        interpolate(morphSourceGains.data(), morphSourceGains.data(), captureGains.data(), morphPosition, numChannels);
+
+    // until the capture has finished, the layer plays morphSource
+    morphing = false;
+    morphPosition = 0.0f;
+}
+
+// There's a step for every hop, so that each grain is renewed from a step of
+// its own, and the last one is the captured spectrum exactly.
+void AutoFreezeEngine::startMorph(float seconds)
+{
+    const int hop = freezeBufferSamples / numGrains;
+    const int morphSamples = std::max(1, secondsToSamples(seconds, sampleRate));
+
+    numMorphSteps = (morphSamples + hop - 1) / hop;
+    morphStepSamples = std::max(1, morphSamples / numMorphSteps);
+    morphStepIndex = 0;
+    morphSamplesLeft = morphStepSamples;
+    morphBin = 0;
+    morphCapture = false;
+    morphing = true;
+}
+
+void AutoFreezeEngine::advanceMorph(int numSamples)
+{
+    const int numBins = freezeBufferSamples / 2 + 1;
+    const int numChannels = freezeMags.getNumChannels();
+    const int numMagnitudeChannels = captureMode == ChannelMode::MidSide ? 1 : numChannels;
+    const int numStepBins = numMagnitudeChannels * numBins;
+    const bool isLastStep = morphStepIndex == numMorphSteps - 1;
+    const float position = static_cast<float>(morphStepIndex + 1) / static_cast<float>(numMorphSteps);
+
+    morphSamplesLeft -= numSamples;
+
+    // the bins of every channel in turn, as many as the step has had samples
+    if (! isLastStep) {
+        const int endBin = morphSamplesLeft <= 0 ? numStepBins
+                         : static_cast<int>(static_cast<std::int64_t>(numStepBins) * (morphStepSamples - morphSamplesLeft) / morphStepSamples);
+
+        while (morphBin < endBin) {
+            const int channel = morphBin / numBins;
+            const int bin = morphBin - channel * numBins;
+            const int numStepChannelBins = std::min(endBin - channel * numBins, numBins) - bin;
+
+            interpolate(morphStep.getWritePointer(channel) + bin, morphSource.getReadPointer(channel) + bin,
+                        freezeMags.getReadPointer(channel) + bin, position, numStepChannelBins);
+            morphBin += numStepChannelBins;
+        }
+    }
+
+    if (morphSamplesLeft > 0)
+        return;
+
+    if (isLastStep) {
+        publishToLayer(*captureLayer, freezeMags, captureMode, captureGains.data());
+        morphing = false;
+        morphPosition = 1.0f;
+        return;
+    }
+
+    interpolate(morphStepGains.data(), morphSourceGains.data(), captureGains.data(), position, numChannels);
+    publishToLayer(*captureLayer, morphStep, captureMode, morphStepGains.data());
+    morphPosition = position;
+    morphStepIndex++;
+    morphSamplesLeft = morphStepSamples;
+    morphBin = 0;
+}
+
+double AutoFreezeEngine::getTailLengthSeconds() const
+{
+    return idle ? 0.0 : std::numeric_limits<double>::infinity();
+}
+
+// both kinds of synthesis follow every spectrum, so either can be heard next
+void AutoFreezeEngine::publishToLayer(FreezeLayer& layer, const SampleBuffer& mags, ChannelMode mode, const float* channelGains)
+{
+    // the loudest bin at each channel's level, against a full scale sine's
+    const int numBins = freezeSize->numSamples / 2 + 1;
+    const int numChannels = freezeMags.getNumChannels();
+    const int numMagnitudeChannels = mode == ChannelMode::MidSide ? 1 : numChannels;
+    float peak = 0.0f;
+
+    for (int channel = 0; channel < numMagnitudeChannels; channel++) {
+        const float* channelMags = mags.getReadPointer(channel);
+        peak = std::max(peak, *std::max_element(channelMags, channelMags + numBins));
+    }
+
+    if (mode == ChannelMode::MidSide && channelGains != nullptr)
+        peak *= *std::max_element(channelGains, channelGains + numChannels);
+
+    layer.isAudible = 2.0f * peak / static_cast<float>(freezeSize->numSamples) > std::pow(10.0f, silenceDb / 20.0f);
+    if (hasGrains)
+        layer.grains.publishSpectrum(mags, freezeSize->order, mode, channelGains);
+
+    layer.stream.setSpectrum(mags, freezeSize->order, mode, channelGains);
+    publishSpectrumView(mags, mode, channelGains);
+}
+
+// Each point takes the loudest bin of its band, so tones stay visible
+// however many bins share a point. Bins below the first band are left out.
+void AutoFreezeEngine::publishSpectrumView(const SampleBuffer& mags, ChannelMode mode, const float* channelGains)
+{
+    auto& view = spectrumViews[static_cast<size_t>(spectrumViewBackIndex)];
+    const int numBins = freezeSize->numSamples / 2 + 1;
+    const int numChannels = freezeMags.getNumChannels();
+    const int numMagnitudeChannels = mode == ChannelMode::MidSide ? 1 : numChannels;
+    float gain = 1.0f;
+
+    // mid/side magnitudes are heard at each channel's own level
+    if (mode == ChannelMode::MidSide && channelGains != nullptr)
+        gain = *std::max_element(channelGains, channelGains + numChannels);
+
+    // a sine's bin is half the freeze size times its amplitude
+    const float fullScale = 2.0f * gain / static_cast<float>(freezeSize->numSamples);
+    const float lastBin = static_cast<float>(numBins - 1);
+
+    for (int point = 0; point < AutoFreezeSpectrumView::numPoints; point++) {
+        const int begin = std::min(numBins - 1, static_cast<int>(spectrumViewEdges[point] * lastBin));
+        const int end = std::clamp(static_cast<int>(spectrumViewEdges[point + 1] * lastBin), begin + 1, numBins);
+        float peak = 0.0f;
+
+        for (int channel = 0; channel < numMagnitudeChannels; channel++) {
+            const float* channelMags = mags.getReadPointer(channel);
+            peak = std::max(peak, *std::max_element(channelMags + begin, channelMags + end));
+        }
+
+        view.dbLevels[point] = gainToDecibels(peak * fullScale);
+    }
+
+    view.maxFrequency = static_cast<float>(sampleRate / 2.0);
+    view.serial = ++spectrumViewSerial;
+    spectrumViewBackIndex = spectrumViewExchange.exchange(spectrumViewBackIndex | spectrumViewDirtyFlag) & spectrumViewIndexMask;
+}
+
+bool AutoFreezeEngine::getSpectrumView (AutoFreezeSpectrumView& view)
+{
+    if ((spectrumViewExchange.load() & spectrumViewDirtyFlag) != 0)
+        spectrumViewFrontIndex = spectrumViewExchange.exchange(spectrumViewFrontIndex) & spectrumViewIndexMask;
+
+    const auto& newest = spectrumViews[static_cast<size_t>(spectrumViewFrontIndex)];
+
+    if (newest.serial == view.serial)
+        return false;
+
+    view = newest;
+    return true;
+}
+
+AutoFreezeEngine::FreezeLayer& AutoFreezeEngine::takeLayer()
+{
+    FreezeLayer* stolen = nullptr;
+    const bool stealQuietest = layerStealing == LayerStealing::Quietest;
+
+    for (auto& layer : layers) {
+        if (! layer->isActive)
+            return *layer;
+
+        if (stolen == nullptr || (stealQuietest ? layer->level < stolen->level : layer->serial < stolen->serial))
+            stolen = layer.get();
+    }
+
+    return *stolen;
+}
+
+AutoFreezeEngine::FreezeLayer* AutoFreezeEngine::getNewestLayer()
+{
+    FreezeLayer* newest = nullptr;
+
+    for (auto& layer : layers) {
+        if (layer->isActive && (newest == nullptr || layer->serial > newest->serial))
+            newest = layer.get();
+    }
+
+    return newest;
+}
+
+void AutoFreezeEngine::readFreeze(SampleBlock& buffer, int numChannels, int blockSize)
+{
+    // the first layer in the mix writes the buffer and the rest add to it
+    bool accumulate = false;
+
+    for (auto& layer : layers) {
+        if (layer->isActive && layer->isAudible) {
+            if (activeSynthesis == Synthesis::Streaming)
+                layer->stream.process(buffer, numChannels, blockSize, accumulate);
+            else
+                readLayer(*layer, buffer, numChannels, blockSize, accumulate);
+
+            accumulate = true;
+        }
+    }
+
+    if (! accumulate) {
+        for (int channel = 0; channel < numChannels; channel++)
+            std::fill_n(buffer.getWritePointer(channel), blockSize, 0.0f);
+    }
+}
+
+void AutoFreezeEngine::readLayer(FreezeLayer& layer, SampleBlock& buffer, int numChannels, int blockSize, bool accumulate)
+{
+    const int layerSamples = layer.size->numSamples;
+    const int hop = layerSamples / numGrains;
+    auto& grainIndices = layer.grainIndices;
+    const bool halfFloats = layer.grains.getActiveGrain(0).getFormat() == GrainBuffer::Format::Float16;
+    std::array<const float*, numGrains> grainData;
+    std::array<const std::uint16_t*, numGrains> halfGrainData;
+    std::array<const float*, numGrains> windowData;
+
+    // overlap-add grains into the buffer, a span between grain wraps at a time
+    for (int sample = 0; sample < blockSize;) {
+        // swap in a resynthesised grain for any grain that has been fully read from
+        for (int grainNum = 0; grainNum < numGrains; grainNum++)
+        {
+            if (grainIndices[grainNum] >= layerSamples) {
+                layer.grains.renewActiveGrain(grainNum, nonRealtime);
+                grainIndices[grainNum] = 0;
+            }
+        }
+
+        int spanSamples = blockSize - sample;
+
+        for (int grainNum = 0; grainNum < numGrains; grainNum++) {
+            spanSamples = std::min(spanSamples, layerSamples - grainIndices[grainNum]);
+            windowData[grainNum] = layer.size->window + grainIndices[grainNum];
+        }
+
+        const float* normalisation = layer.size->normalisation + grainIndices[0] % hop;
+
+        for (int channel = 0; channel < numChannels; channel++) {
+            float* dest = buffer.getWritePointer(channel) + sample;
+
+            if (halfFloats) {
+                for (int grainNum = 0; grainNum < numGrains; grainNum++)
+                    halfGrainData[grainNum] = layer.grains.getActiveGrain(grainNum).getHalfPointer(channel) + grainIndices[grainNum];
+
+                overlapAdd<numGrains>(dest, halfGrainData.data(), windowData.data(), normalisation, spanSamples, accumulate);
+                continue;
+            }
+
+            for (int grainNum = 0; grainNum < numGrains; grainNum++) {
+                grainData[grainNum] = layer.grains.getActiveGrain(grainNum).getFloatPointer(channel) + grainIndices[grainNum];
+            }
+
+            overlapAdd<numGrains>(dest, grainData.data(), windowData.data(), normalisation, spanSamples, accumulate);
+        }
+
+        for (int grainNum = 0; grainNum < numGrains; grainNum++) {
+            grainIndices[grainNum] += spanSamples;
+        }
+
+        sample += spanSamples;
+    }
+}
+
+void AutoFreezeEngine::processBelowThreshold(SampleBlock& buffer)
+{
+    // the dry signal isn't heard here, so the freeze can be read straight into the output
+    readFreeze(buffer, buffer.getNumChannels(), buffer.getNumSamples());
+}
+
+void AutoFreezeEngine::processPredelay(SampleBlock& buffer)
+{
+    SampleBlock freeze = freezeScratch.getBlock(0, buffer.getNumSamples());
+    readFreeze(freeze, buffer.getNumChannels(), buffer.getNumSamples());
+
+    for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+    {
+        float* bufferChannelData = buffer.getWritePointer(channel);
+        const float* freezeChannelData = freeze.getReadPointer(channel);
+
+        for (int sample = 0; sample < buffer.getNumSamples(); sample++)
+        {
+            float fade_in_factor = 1;
+            float fade_out_factor = 0;
+
+            if (shortFadeIndex + sample < shortFade.length)
+            {
+                fade_in_factor = shortFade.fadeIn[shortFadeIndex + sample];
+                fade_out_factor = shortFade.fadeOut[shortFadeIndex + sample];
+            }
+
+            float faded_in_dry = bufferChannelData[sample] * fade_in_factor;
+            float faded_out_wet = freezeChannelData[sample] * fade_out_factor;
+
+            bufferChannelData[sample] = faded_in_dry + faded_out_wet;
+
+        }
+    }
+
+    predelayCounter += buffer.getNumSamples();
+    shortFadeIndex += buffer.getNumSamples();
+}
+
+void AutoFreezeEngine::processReadingFreeze(SampleBlock& buffer)
+{
+    // the capture is worked on once the freeze buffer is full, and runs are
+    // split so that a run never does both
+    if (freezeBufferIndex >= freezeBufferSamples) {
+        if (! parallelCapture)
+            advanceCapture(buffer.getNumSamples());
+
+        return;
+    }
+
+    const int numSamples = std::min(buffer.getNumSamples(), freezeBufferSamples - freezeBufferIndex);
+
+    for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
+        freezeBuffer.copyFrom(channel, freezeBufferIndex, buffer.getReadPointer(channel), numSamples);
+    }
+
+    freezeBufferIndex += numSamples;
+}
+
+void AutoFreezeEngine::processCooldown(SampleBlock& buffer)
+{
+    SampleBlock freeze = freezeScratch.getBlock(0, buffer.getNumSamples());
+    readFreeze(freeze, buffer.getNumChannels(), buffer.getNumSamples());
+
+    for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+    {
+        float* bufferChannelData = buffer.getWritePointer(channel);
+        const float* freezeChannelData = freeze.getReadPointer(channel);
+
+        for (int sample = 0; sample < buffer.getNumSamples(); sample++)
+        {
+            float fade_in_factor = 1;
+            float fade_out_factor = 0;
+
+            if (longFadeIndex + sample < longFade.length)
+            {
+                fade_in_factor = longFade.fadeIn[longFadeIndex + sample];
+                fade_out_factor = longFade.fadeOut[longFadeIndex + sample];
+            }
+
+            float faded_in_wet = freezeChannelData[sample] * fade_in_factor;
+            float faded_out_dry = bufferChannelData[sample] * fade_out_factor;
+
+            bufferChannelData[sample] = faded_in_wet + faded_out_dry;
+
+        }
+    }
+
+    coolDownCounter += buffer.getNumSamples();
+    longFadeIndex += buffer.getNumSamples();
+}
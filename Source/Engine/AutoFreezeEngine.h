@@ -0,0 +1,572 @@
+/*
+  ==============================================================================
+
+    AutoFreezeEngine.h
+
+    The AutoFreeze DSP, independent of JUCE and of any plugin host. The plugin
+    processor wraps one of these, and command line tools can drive it directly.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "FadeTables.h"
+#include "Fft.h"
+#include "FreezeBank.h"
+#include "FreezeState.h"
+#include "GrainPool.h"
+#include "GrainWorker.h"
+#include "LevelDetector.h"
+#include "RandomPhaseSpectrum.h"
+#include "SampleBuffer.h"
+#include "SharedTables.h"
+#include "SpectralStream.h"
+#include "SpscFifo.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//==============================================================================
+/**
+*/
+enum class AutoFreezeState
+{
+    BelowThreshold,
+    Predelay,
+    ReadingFreeze,
+    Cooldown
+};
+
+const char* getStateName (AutoFreezeState state);
+
+//==============================================================================
+/** What the engine did in one call to process, published from the audio thread.
+*/
+struct AutoFreezeTelemetry
+{
+    std::uint64_t blockIndex = 0;
+    AutoFreezeState state = AutoFreezeState::BelowThreshold;
+    int numSamples = 0;
+    float inputRms = 0.0f;          // averaged over channels
+    float outputRms = 0.0f;
+    float outputPeak = 0.0f;
+    float outputEnvelope = 0.0f;    // outputRms smoothed for metering
+    float processingSeconds = 0.0f;
+    float budgetSeconds = 0.0f;     // numSamples / sample rate
+    int grainRenewals = 0;          // fresh grains swapped in during this block
+    int activeLayers = 0;           // layers in the mix
+    bool idle = false;              // nothing was synthesised, only the input was measured
+
+    // running totals since prepare
+    int grainUnderruns = 0;
+    int overruns = 0;
+    float maxProcessingSeconds = 0.0f;
+};
+
+//==============================================================================
+/** The spectrum the newest layer plays, reduced to a point per pixel or so
+    for drawing, published from the audio thread whenever it changes.
+*/
+struct AutoFreezeSpectrumView
+{
+    static constexpr int numPoints = 256;
+    static constexpr float minFrequency = 20.0f;
+    static constexpr float minDb = -100.0f;
+
+    // The loudest bin around each of numPoints frequencies, spaced evenly on
+    // a log scale from minFrequency to maxFrequency. 0 dB is a full scale sine.
+    std::array<float, numPoints> dbLevels {};
+    float maxFrequency = 0.0f;
+    std::uint64_t serial = 0;   // 0 before the first spectrum, then counts every one published
+};
+
+//==============================================================================
+/**
+*/
+class AutoFreezeEngine
+{
+public:
+    //==============================================================================
+    AutoFreezeEngine();
+    ~AutoFreezeEngine();
+
+    //==============================================================================
+    // allocates, so call these while audio isn't running
+    void prepare (double sampleRate, int maximumBlockSize, int numChannels);
+    void reset();
+    void release();
+
+    // real-time safe, numSamples may be anything up to maximumBlockSize or beyond
+    void process (float* const* channels, int numChannels, int numSamples);
+
+    //==============================================================================
+    void setNonRealtime (bool isNonRealtime) { nonRealtime = isNonRealtime; }
+    void setDeterministicSeed (std::uint64_t seed);
+
+    // In rolling capture mode the input is always kept in a ring buffer, and a
+    // freeze is taken from the most recent window, lookbackSeconds ago, as soon
+    // as the dry signal has faded in, rather than read after the predelay.
+    void setRollingCapture (bool shouldRoll) { rollingCapture = shouldRoll; }
+    void setCaptureLookbackSeconds (float lookbackSeconds);
+    bool isRollingCapture() const { return rollingCapture; }
+
+    // Linked stereo analyses and resynthesises channels in pairs, one complex
+    // FFT for two channels. Mid/side analyses only the mid signal and shares
+    // its magnitudes, at each channel's own level, which halves the spectral
+    // work for stereo at the cost of width. Taken up at the next capture.
+    void setChannelMode (ChannelMode newMode) { channelMode = newMode; }
+    ChannelMode getChannelMode() const { return channelMode; }
+
+    // The freeze is 2^order samples long, from minFreezeOrder for short,
+    // percussive freezes to maxFreezeOrder for smooth pads. Every size up to
+    // the largest freeze order is prepared up front, so this never allocates,
+    // and larger ones are captured at that size. Taken up at the next capture.
+    void setFreezeOrder (int newOrder);
+    int getFreezeOrder() const { return requestedFreezeOrder; }
+
+    // The largest freeze the engine is prepared for. Everything that scales
+    // with the freeze size is allocated for it, so the default keeps an
+    // instance to a few megabytes and the larger sizes cost memory only when
+    // they're asked for. Taken up by the next prepare.
+    void setLargestFreezeOrder (int newOrder) { requestedLargestFreezeOrder = std::clamp (newOrder, minFreezeOrder, maxFreezeOrder); }
+    int getLargestFreezeOrder() const { return largestFreezeOrder; }
+
+    // For sessions with many instances. A compact engine is only prepared
+    // for freezes up to compactMaxFreezeOrder, larger ones are captured and
+    // restored at that size, and its grains are kept as 16 bit half floats,
+    // with two spares instead of four. It only sets memory aside for what
+    // it's prepared with: the lookback it's set to, morphing if there's a
+    // morph time, and no grains at all if it's streaming, so it can't
+    // switch to any of them until it's prepared again. Past the tables every
+    // instance shares, a stereo instance at 48 kHz holds about 1.4 MB with
+    // grains and 0.55 MB streaming, next to 2.3 MB for one that isn't
+    // compact. Taken up by the next prepare.
+    void setCompactMemory (bool shouldBeCompact) { compactMemory = shouldBeCompact; }
+    bool isCompactMemory() const { return compactMemory; }
+
+    // Every capture goes to a layer of its own, with its own spectrum, grains
+    // and size, and the layers play together. They're allocated by prepare,
+    // as many as were asked for that fit in the memory budget, and once they
+    // are all playing a new capture takes over the oldest or the quietest.
+    enum class LayerStealing { Oldest, Quietest };
+    void setNumLayers (int newNumLayers) { requestedNumLayers = std::clamp (newNumLayers, 1, maxNumLayers); }
+    void setLayerMemoryBudget (std::size_t numBytes) { layerMemoryBudget = numBytes; }
+    void setLayerStealing (LayerStealing newStealing) { layerStealing = newStealing; }
+    int getNumLayers() const { return static_cast<int> (layers.size()); }
+
+    // With a morph time, a capture of the same size and channel mode as the
+    // newest layer doesn't take a layer, it moves that layer from the
+    // spectrum it was playing to the new one over morphSeconds. The grains
+    // are renewed from the spectrum in between, a hop's worth of the
+    // interpolation at a time. 0 turns morphing off for captures, restores
+    // and recalls of the same size and mode morph over the long fade instead.
+    void setMorphSeconds (float newSeconds);
+    bool isMorphing() const { return morphing; }
+
+    // Grains overlaps the four freeze length grains each capture
+    // resynthesises. Streaming instead resynthesises short frames from the
+    // same spectrum, a hop at a time, so every block costs about the same
+    // and the texture changes continuously. Taken up by the next block, and
+    // a layer that switches to streaming fades in over a frame. A compact
+    // engine prepared for streaming has no grains to switch back to.
+    enum class Synthesis { Grains, Streaming };
+    void setSynthesis (Synthesis newSynthesis) { synthesis = newSynthesis; }
+    Synthesis getSynthesis() const { return synthesis; }
+
+    // A layer whose loudest bin is below silenceDb is left out of the mix,
+    // so nothing is synthesised for it until it's given a louder spectrum.
+    // Below the threshold with no layer left in the mix the engine is idle,
+    // and only measures the input, which wakes it on the very next block.
+    // The tail is 0 while idle, and infinite otherwise, since a freeze
+    // carries on after the input stops.
+    bool isIdle() const { return idle; }
+    double getTailLengthSeconds() const;
+
+    // Threshold and timings, clamped to the ranges below. They never
+    // allocate: the fade tables are rebuilt in the background and taken up
+    // by the next fade, the rest is taken up by the next block.
+    void setThresholdDb (float newThresholdDb);
+    void setPredelaySeconds (float newSeconds);
+    void setCooldownSeconds (float newSeconds);
+    void setShortFadeSeconds (float newSeconds);
+    void setLongFadeSeconds (float newSeconds);
+
+    double getSampleRate() const { return sampleRate; }
+    int getMaximumBlockSize() const { return freezeScratch.getNumSamples(); }
+    int getNumChannels() const { return freezeBuffer.getNumChannels(); }
+    AutoFreezeState getState() const { return currentState; }
+    float getDbLevel() const { return dbLevel; }
+    int getNumGrainUnderruns() const;
+    int getNumOverruns() const { return numOverruns; }
+    float getMaxProcessingSeconds() const { return maxProcessingSeconds; }
+
+    // Telemetry is published once per call to process. Frames are dropped if
+    // nobody reads them, and only one thread may read them, without locking.
+    bool popTelemetry (AutoFreezeTelemetry& frame) { return telemetry.pop (frame); }
+
+    // Copies the newest spectrum view into view, unless view already holds
+    // it, and returns whether it did. Only one thread may read the views.
+    bool getSpectrumView (AutoFreezeSpectrumView& view);
+
+    // The freeze, saved with a session. getFreezeState encodes the most recent
+    // capture or restore, and returns false if there isn't one. A restored
+    // freeze takes over from the next block that doesn't start mid capture,
+    // without a new capture, morphing the newest layer to it if they're the
+    // same size and mode, even if it arrives before prepare, and one larger
+    // than the engine is prepared for is resampled to the largest size. Both
+    // allocate, so call them from the message thread.
+    bool getFreezeState (std::vector<std::uint8_t>& destData, FreezeState::Encoding encoding);
+    bool restoreFreezeState (const void* data, std::size_t numBytes);
+
+    // A bank of snapshots, usually a memory mapped file that must outlive it
+    // or the next call, with nullptr to close it. Recalling a snapshot is real
+    // time safe: it's read from the bank in the background, then restored
+    // like a saved freeze.
+    bool setSnapshotBank (const void* data, std::size_t numBytes);
+    const FreezeBank& getSnapshotBank() const { return snapshotBank; }
+    void recallSnapshot (int index) { snapshotBank.recall (index); }
+
+    // Recalls from the host, on the audio thread. The snapshot parameter
+    // recalls snapshot n - 1 when it changes to n, and 0 leaves the freeze
+    // alone. Without shouldRecall the value is only remembered, for a
+    // restored session. A MIDI program change recalls bank * 128 + program,
+    // with the bank from the last controller 0.
+    void setSnapshotParameter (int snapshot, bool shouldRecall = true);
+    void handleMidiMessage (const std::uint8_t* data, int numBytes);
+
+    //==============================================================================
+    void updateState();
+    void readIntoGrain (int grainNum);
+    void calculateFreezeMagnitudes();
+    void readFreeze (SampleBlock& buffer, int numChannels, int blockSize);
+    void processBelowThreshold (SampleBlock&);
+    void processPredelay (SampleBlock&);
+    void processReadingFreeze (SampleBlock&);
+    void processCooldown (SampleBlock&);
+
+    //==============================================================================
+    static constexpr int minFreezeOrder = 11;
+    static constexpr int maxFreezeOrder = 17;
+    static constexpr int defaultFreezeOrder = 14;
+    static constexpr int maxFreezeBufferSamples = 1 << maxFreezeOrder;
+    static constexpr int compactMaxFreezeOrder = defaultFreezeOrder;
+    static constexpr int numGrains = 4;
+    static constexpr int numSpareGrains = 4;
+    static constexpr int compactNumSpareGrains = 2;
+    static constexpr int maxNumLayers = 16;
+    static constexpr std::size_t defaultLayerMemoryBudget = std::size_t (128) << 20;
+
+    static constexpr float minThresholdDb = -60.0f;
+    static constexpr float maxThresholdDb = 0.0f;
+    static constexpr float defaultThresholdDb = -20.0f;
+    static constexpr float maxPredelaySeconds = 1.0f;
+    static constexpr float defaultPredelaySeconds = 0.1f;
+    static constexpr float minCooldownSeconds = 0.1f;
+    static constexpr float maxCooldownSeconds = 10.0f;
+    static constexpr float defaultCooldownSeconds = 1.0f;
+    static constexpr float minFadeSeconds = 0.001f;
+    static constexpr float maxShortFadeSeconds = 0.5f;
+    static constexpr float defaultShortFadeSeconds = 0.05f;
+    static constexpr float maxLongFadeSeconds = 2.0f;
+    static constexpr float defaultLongFadeSeconds = 0.1f;
+    static constexpr float maxMorphSeconds = 10.0f;
+    static constexpr float silenceDb = -120.0f;
+
+    static constexpr float captureSpreadSeconds = 0.05f;
+    static constexpr float maxCaptureLookbackSeconds = 0.5f;
+    static constexpr float levelAttackSeconds = 0.01f;
+    static constexpr float levelReleaseSeconds = 0.3f;
+
+private:
+    //==============================================================================
+    void updateParameters();
+    void processSubBlock (SampleBlock&);
+    int getNumSamplesUntilTransition (int numSamplesAvailable) const;
+    void writeToRing (const SampleBlock&);
+    void storeFreezeState();
+    void takeRestoredFreezeState();
+
+    struct FreezeLayer;
+    FreezeLayer& takeLayer();
+    FreezeLayer* getNewestLayer();
+    void readLayer (FreezeLayer&, SampleBlock& buffer, int numChannels, int blockSize, bool accumulate);
+    void publishToLayer (FreezeLayer&, const SampleBuffer& mags, ChannelMode mode, const float* channelGains);
+    void publishSpectrumView (const SampleBuffer& mags, ChannelMode mode, const float* channelGains);
+    int getNumGrainRenewals() const;
+
+    // A morph is a list of steps a hop apart, each one published to the
+    // layer once it's finished. The magnitudes of the next step are
+    // interpolated a few bins per sample, like the capture tasks.
+    void startMorphCapture();
+    void startMorph (float seconds);
+    void advanceMorph (int numSamples);
+
+    // The capture is analysed and resynthesised as a list of tasks, each
+    // worth one FFT pass, that are worked through a few units per sample so
+    // that no single block pays for every transform at once. It always takes
+    // the same number of samples, whatever the block sizes.
+    // The Pair tasks work on two channels at once in one complex transform of
+    // twice the size, and the Shared tasks on the mid signal in channel 0.
+    enum class CaptureTaskType
+    {
+        Window,
+        ForwardPass,
+        StoreMagnitudes,
+        PublishSpectrum,
+        RandomisePhases,
+        ToCartesian,
+        InversePass,
+        StoreGrain,
+        WindowPair,
+        ComplexForwardPass,
+        StorePairMagnitudes,
+        PairToCartesian,
+        ComplexInversePass,
+        StorePairGrain,
+        WindowShared,
+        StoreSharedGrain
+    };
+
+    struct CaptureTask
+    {
+        CaptureTaskType type;
+        int channel;
+        int grain;
+        int pass;
+    };
+
+    static constexpr int numChannelModes = 3;
+
+    // Everything that depends on the freeze size, built for every size when
+    // the engine is prepared. Each channel mode has a task list, and the first
+    // channel of every channel or pair that the list analyses on its own.
+    struct FreezeSize
+    {
+        explicit FreezeSize (int order);
+
+        void prepare (double sampleRate, int numChannels);
+        void buildCaptureTasks (ChannelMode mode, int numChannels);
+        int getNumUnits (const CaptureTask&) const;
+
+        int order;
+        int numSamples;
+
+        // shared with every other engine in the process, read only
+        std::shared_ptr<const Fft> fft;
+        std::shared_ptr<const Fft> pairFft;
+        std::shared_ptr<const SharedTables::Window> windows;
+        const float* window;
+        const float* normalisation;
+
+        std::array<std::vector<CaptureTask>, numChannelModes> captureTasks;
+        std::array<std::vector<int>, numChannelModes> captureSlots;
+        std::array<std::int64_t, numChannelModes> captureUnitsPerSample {};
+        std::array<int, numChannelModes> captureSamples {};
+    };
+
+    void selectFreezeSize (int order);
+    const std::vector<CaptureTask>& getCaptureTasks() const { return freezeSize->captureTasks[static_cast<size_t> (captureMode)]; }
+    const std::vector<int>& getCaptureSlots() const { return freezeSize->captureSlots[static_cast<size_t> (captureMode)]; }
+    void publishCapturedSpectrum();
+    void runCaptureTask (const CaptureTask&, int beginUnit, int endUnit, float* scratch, RandomPhaseSpectrum& phases);
+    void runWholeCaptureTasks (int channel, int grain, float* scratch, RandomPhaseSpectrum& phases);
+    void advanceCapture (int numSamples);
+
+    // With many channels the capture is handed to a few worker threads
+    // instead, a stage at a time: analysis per channel, publishing the
+    // spectrum, drawing the grain phases, then synthesis per grain and channel.
+    static constexpr int parallelChannelThreshold = 8;
+    static constexpr int maxSpectralWorkers = 4;
+    static constexpr int numParallelCaptureStages = 4;
+
+    void stopParallelCapture();
+    bool advanceParallelCapture();
+    static void runParallelCaptureItem (void* engine, int item, int threadIndex);
+
+    double sampleRate = 44100.0;
+    bool nonRealtime = false;
+
+    AutoFreezeState currentState = AutoFreezeState::BelowThreshold;
+
+    std::atomic<float> dbLevel { -100.0f };
+
+    // levels of each block on the way in and out, measured once and shared
+    // by the state machine, the grain targets and the meters
+    LevelDetector inputLevels;
+    LevelDetector outputLevels;
+
+    // telemetry, the fifo is sized once so a reader never sees it
+    // reallocate, and the editor drains it every frame
+    static constexpr int telemetryCapacity = 256;
+    SpscFifo<AutoFreezeTelemetry> telemetry;
+    std::uint64_t blockIndex = 0;
+    std::atomic<int> numOverruns { 0 };
+    std::atomic<float> maxProcessingSeconds { 0.0f };
+
+    // freeze sizes up to the largest prepared, freezeSize is the one that
+    // the last capture used
+    std::vector<std::unique_ptr<FreezeSize>> freezeSizes;
+    const FreezeSize* freezeSize = nullptr;
+    std::atomic<int> requestedFreezeOrder { defaultFreezeOrder };
+    std::atomic<bool> compactMemory { false };
+    std::atomic<int> requestedLargestFreezeOrder { defaultFreezeOrder };
+    std::atomic<int> largestFreezeOrder { defaultFreezeOrder };
+
+    // freeze buffer, big enough for the largest size
+    SampleBuffer freezeBuffer;
+    int freezeBufferSamples = 1 << defaultFreezeOrder;
+    int freezeBufferIndex = 0;
+
+    // rolling capture, freezeBuffer holds maxLookbackSamples more than a
+    // freeze so that the ring can reach back past the most recent window
+    std::atomic<bool> rollingCapture { false };
+    std::atomic<float> captureLookbackSeconds { 0.0f };
+    int maxLookbackSamples = 0;
+    int freezeRingIndex = 0;
+    int captureStartIndex = 0;
+
+    // grains, freezeMags holds the bins up to Nyquist
+    SampleBuffer freezeMags;
+    RandomPhaseSpectrum grainPhases;
+
+    // layers, each plays the grains of one capture at its own size, or
+    // streams frames of the smallest size from the same spectrum
+    struct FreezeLayer
+    {
+        GrainPool grains;
+        SpectralStream stream;
+        std::array<int, numGrains> grainIndices {};
+        const FreezeSize* size = nullptr;
+        ChannelMode mode = ChannelMode::Independent;
+        bool isActive = false;
+        bool isAudible = false;     // its spectrum is louder than silenceDb
+        std::uint64_t serial = 0;   // orders the layers by their last capture or restore
+        float level = 0.0f;         // the input level the capture took over from
+    };
+
+    std::vector<std::unique_ptr<FreezeLayer>> layers;
+    FreezeLayer* captureLayer = nullptr;
+    GrainWorker grainWorker;    // after the layers, so it stops before they go
+    std::uint64_t layerSerial = 0;
+    std::atomic<int> requestedNumLayers { 1 };
+    std::atomic<std::size_t> layerMemoryBudget { defaultLayerMemoryBudget };
+    std::atomic<LayerStealing> layerStealing { LayerStealing::Oldest };
+    std::atomic<Synthesis> synthesis { Synthesis::Grains };
+    Synthesis activeSynthesis = Synthesis::Grains;
+    bool hasGrains = true;          // false for a compact engine prepared for streaming
+    std::atomic<bool> idle { true };
+    std::atomic<bool> hasDeterministicSeed { false };
+    std::atomic<std::uint64_t> deterministicSeed { 0 };
+
+    // morphing, morphSource is what the layer was playing when the capture
+    // started and freezeMags is where the morph ends up
+    std::atomic<float> morphSeconds { 0.0f };
+    bool hasMorphBuffers = true;    // false for a compact engine prepared without a morph time
+    bool morphCapture = false;
+    bool morphing = false;
+    SampleBuffer morphSource;
+    SampleBuffer morphStep;
+    std::vector<float> morphSourceGains;
+    std::vector<float> morphStepGains;
+    float morphPosition = 1.0f;     // how much of freezeMags the layer is playing
+    int numMorphSteps = 0;
+    int morphStepIndex = 0;
+    int morphStepSamples = 0;
+    int morphSamplesLeft = 0;       // until the step is published
+    int morphBin = 0;
+
+    // capture
+    std::atomic<ChannelMode> channelMode { ChannelMode::Independent };
+    ChannelMode captureMode = ChannelMode::Independent;
+    size_t captureTaskIndex = 0;
+    int captureUnit = 0;
+    std::int64_t captureCredit = 0;
+    int captureSamplesLeft = 0;
+
+    // mid/side, the energy of each channel and of the mid signal in the window
+    std::vector<double> captureEnergies;
+    std::vector<float> captureGains;
+
+    // parallel capture
+    bool parallelCapture = false;
+    int parallelCaptureStage = 0;
+    std::vector<std::vector<float>> spectralWorkerScratch;
+    std::array<RandomPhaseSpectrum, numGrains> parallelGrainPhases;
+
+    // saved freeze, captures and restores store it and getFreezeState reads
+    // it. A store that finds it being read is left pending until a block
+    // that isn't mid capture, so the audio thread never waits.
+    enum SavedFreezeStatus { savedFreezeIdle, savedFreezeStoring, savedFreezeReading };
+    FreezeState savedFreeze;
+    std::atomic<int> savedFreezeStatus { savedFreezeIdle };
+    std::atomic<bool> savedFreezePending { false };  // a parallel capture's worker stores too
+    bool hasFreeze = false;         // since the last reset
+
+    // spectrum view, a triple buffer, and the edges of each point's band as
+    // fractions of Nyquist
+    static constexpr int spectrumViewDirtyFlag = 4;
+    static constexpr int spectrumViewIndexMask = 3;
+    std::array<AutoFreezeSpectrumView, 3> spectrumViews;
+    std::atomic<int> spectrumViewExchange { 1 };
+    int spectrumViewBackIndex = 2;
+    int spectrumViewFrontIndex = 0;
+    std::array<float, AutoFreezeSpectrumView::numPoints + 1> spectrumViewEdges {};
+    std::uint64_t spectrumViewSerial = 0;
+
+    // restored freeze, handed over once from restoreFreezeState to the audio thread
+    enum RestoreStatus { restoreEmpty, restoreWriting, restoreReady, restoreTaking };
+    FreezeState restoredFreeze;
+    std::atomic<int> restoreStatus { restoreEmpty };
+
+    // snapshot bank, its loader restores recalled snapshots
+    FreezeBank snapshotBank;
+    std::atomic<int> lastSnapshotParameter { 0 };
+    int midiSnapshotBank = 0;
+
+    // scratch
+    std::vector<float> fftScratch;
+    SampleBuffer freezeScratch;
+
+    // parameters, written from any thread, the audio thread only loads them
+    std::atomic<float> thresholdDb { defaultThresholdDb };
+    std::atomic<float> predelaySeconds { defaultPredelaySeconds };
+    std::atomic<float> cooldownSeconds { defaultCooldownSeconds };
+    std::atomic<float> shortFadeSeconds { defaultShortFadeSeconds };
+    std::atomic<float> longFadeSeconds { defaultLongFadeSeconds };
+
+    // predelay
+    int predelaySamples = 0;
+    int predelayCounter = 0;
+
+    // cooldown
+    int cooldownSamples = 0;
+    int coolDownCounter = 0;
+
+    // fades, each one keeps the table it started with until it has finished
+    static constexpr int shortFadeTable = 0;
+    static constexpr int longFadeTable = 1;
+    FadeTables fadeTables;
+
+    // short fade
+    FadeTables::Fade shortFade;
+    int shortFadeIndex = 0;
+
+    // long fade
+    FadeTables::Fade longFade;
+    int longFadeIndex = 0;
+
+    // parallel capture workers, last so that they stop before anything
+    // their items use goes
+    WorkerPool spectralWorkers;
+
+    //==============================================================================
+    AutoFreezeEngine (const AutoFreezeEngine&) = delete;
+    AutoFreezeEngine& operator= (const AutoFreezeEngine&) = delete;
+};
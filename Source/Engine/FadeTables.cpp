@@ -0,0 +1,105 @@
+/*
+  ==============================================================================
+
+    FadeTables.cpp
+
+  ==============================================================================
+*/
+
+#include "FadeTables.h"
+
+#include <algorithm>
+
+//==============================================================================
+FadeTables::~FadeTables()
+{
+    release();
+}
+
+void FadeTables::prepare (int numFadesToUse, const int* maxLengths, const int* lengths)
+{
+    release();
+
+    numFades = std::min (numFadesToUse, maxNumFades);
+
+    for (int fade = 0; fade < numFades; fade++)
+    {
+        auto& slot = slots[static_cast<size_t> (fade)];
+        slot.maxLength = std::max (1, maxLengths[fade]);
+
+        for (auto& table : slot.tables)
+            table = {};
+
+        slot.builtLength = std::clamp (lengths[fade], 1, slot.maxLength);
+        slot.requestedLength = slot.builtLength;
+        slot.exchange = 1;
+        slot.backIndex = 2;
+        slot.frontIndex = 0;
+        build (slot.tables[0], slot.builtLength);
+    }
+
+    builderShouldExit = false;
+    builder = std::thread ([this] { run(); });
+}
+
+void FadeTables::release()
+{
+    if (builder.joinable())
+    {
+        builderShouldExit = true;
+        builderWakeup.signal();
+        builder.join();
+    }
+}
+
+//==============================================================================
+void FadeTables::setLength (int fade, int length)
+{
+    auto& slot = slots[static_cast<size_t> (fade)];
+    const int clampedLength = std::clamp (length, 1, std::max (1, slot.maxLength));
+
+    // this is called for every block, but only a new length wakes the builder
+    if (slot.requestedLength.exchange (clampedLength) != clampedLength)
+        builderWakeup.signal();
+}
+
+FadeTables::Fade FadeTables::acquire (int fade)
+{
+    auto& slot = slots[static_cast<size_t> (fade)];
+
+    if ((slot.exchange.load() & dirtyFlag) != 0)
+        slot.frontIndex = slot.exchange.exchange (slot.frontIndex) & indexMask;
+
+    const auto& table = slot.tables[static_cast<size_t> (slot.frontIndex)];
+    return { table.curve->fadeIn.data(), table.curve->fadeOut.data(), table.length };
+}
+
+//==============================================================================
+// replacing the back table's curve frees it if no other engine uses it,
+// which is fine here on the builder thread
+void FadeTables::build (Table& table, int length)
+{
+    table.curve = SharedTables::getFadeCurve (length);
+    table.length = length;
+}
+
+void FadeTables::run()
+{
+    while (! builderShouldExit)
+    {
+        for (int fade = 0; fade < numFades; fade++)
+        {
+            auto& slot = slots[static_cast<size_t> (fade)];
+            const int length = slot.requestedLength.load();
+
+            if (length == slot.builtLength)
+                continue;
+
+            build (slot.tables[static_cast<size_t> (slot.backIndex)], length);
+            slot.builtLength = length;
+            slot.backIndex = slot.exchange.exchange (slot.backIndex | dirtyFlag) & indexMask;
+        }
+
+        builderWakeup.wait();
+    }
+}
@@ -0,0 +1,95 @@
+/*
+  ==============================================================================
+
+    FadeTables.h
+
+    Equal power fade in and fade out tables whose lengths can change while
+    audio is running. A background thread rebuilds a table when its length
+    changes, woken by the change rather than polling, and the audio thread
+    picks up the new one between fades without locking or allocating. The curves themselves come from SharedTables, so
+    engines with fades of the same length share them.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Semaphore.h"
+#include "SharedTables.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+//==============================================================================
+/**
+*/
+class FadeTables
+{
+public:
+    static constexpr int maxNumFades = 2;
+
+    struct Fade
+    {
+        const float* fadeIn = nullptr;
+        const float* fadeOut = nullptr;
+        int length = 0;
+    };
+
+    //==============================================================================
+    FadeTables() = default;
+    ~FadeTables();
+
+    // looks up the initial tables and starts the builder thread, so call
+    // this while audio isn't running
+    void prepare (int numFades, const int* maxLengths, const int* lengths);
+    void release();
+
+    // any thread, lengths are clamped to 1..maxLength
+    void setLength (int fade, int length);
+
+    // audio thread, takes up the most recently built table for a fade that's
+    // about to start, and the returned table stays valid until the next call
+    Fade acquire (int fade);
+
+private:
+    //==============================================================================
+    // only ever released by the builder or while preparing, never by the
+    // audio thread
+    struct Table
+    {
+        std::shared_ptr<const SharedTables::FadeCurve> curve;
+        int length = 0;
+    };
+
+    // a triple buffer per fade, the builder writes the back table and the
+    // audio thread reads the front one
+    struct Slot
+    {
+        std::array<Table, 3> tables;
+        int maxLength = 0;
+        std::atomic<int> requestedLength { 0 };
+        int builtLength = 0;
+        std::atomic<int> exchange { 1 };
+        int backIndex = 2;
+        int frontIndex = 0;
+    };
+
+    static void build (Table&, int length);
+    void run();
+
+    static constexpr int dirtyFlag = 4;
+    static constexpr int indexMask = 3;
+
+    std::array<Slot, maxNumFades> slots;
+    int numFades = 0;
+
+    std::thread builder;
+    Semaphore builderWakeup;
+    std::atomic<bool> builderShouldExit { false };
+
+    //==============================================================================
+    FadeTables (const FadeTables&) = delete;
+    FadeTables& operator= (const FadeTables&) = delete;
+};
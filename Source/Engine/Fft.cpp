@@ -0,0 +1,249 @@
+/*
+  ==============================================================================
+
+    Fft.cpp
+
+  ==============================================================================
+*/
+
+#include "Fft.h"
+
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+//==============================================================================
+Fft::Fft (int order)
+    : size (1 << order), complexOrder (order - 1), complexSize (1 << (order - 1))
+{
+    assert (order >= 2);
+
+    bitReversed.resize (static_cast<size_t> (complexSize));
+
+    for (int i = 0; i < complexSize; i++)
+    {
+        int reversed = 0;
+
+        for (int bit = 0; bit < complexOrder; bit++)
+            reversed |= ((i >> bit) & 1) << (complexOrder - 1 - bit);
+
+        bitReversed[static_cast<size_t> (i)] = reversed;
+    }
+
+    const double twoPi = 6.283185307179586;
+
+    twiddles.resize (static_cast<size_t> (complexSize));
+
+    for (int k = 0; k < complexSize / 2; k++)
+    {
+        const double angle = -twoPi * k / complexSize;
+        twiddles[static_cast<size_t> (2 * k)] = static_cast<float> (std::cos (angle));
+        twiddles[static_cast<size_t> (2 * k + 1)] = static_cast<float> (std::sin (angle));
+    }
+
+    realTwiddles.resize (static_cast<size_t> (complexSize + 2));
+
+    for (int k = 0; k <= complexSize / 2; k++)
+    {
+        const double angle = -twoPi * k / size;
+        realTwiddles[static_cast<size_t> (2 * k)] = static_cast<float> (std::cos (angle));
+        realTwiddles[static_cast<size_t> (2 * k + 1)] = static_cast<float> (std::sin (angle));
+    }
+}
+
+//==============================================================================
+void Fft::performComplex (float* data, bool inverse) const
+{
+    const int passLength = getPassLength();
+
+    bitReverse (data, 0, passLength);
+
+    for (int half = 1; half < complexSize; half *= 2)
+        butterflies (data, half, inverse, 0, passLength);
+}
+
+// each unit swaps the entries of two indices with their bit reversed partners
+void Fft::bitReverse (float* data, int beginUnit, int endUnit) const
+{
+    for (int i = 2 * beginUnit; i < 2 * endUnit; i++)
+    {
+        const int j = bitReversed[static_cast<size_t> (i)];
+
+        if (i < j)
+        {
+            std::swap (data[2 * i], data[2 * j]);
+            std::swap (data[2 * i + 1], data[2 * j + 1]);
+        }
+    }
+}
+
+// each unit is one butterfly of the stage that combines transforms of size half
+void Fft::butterflies (float* data, int half, bool inverse, int beginUnit, int endUnit) const
+{
+    const float conjugate = inverse ? -1.0f : 1.0f;
+    const int twiddleStride = complexSize / (2 * half);
+
+    int start = beginUnit / half * 2 * half;
+    int k = beginUnit % half;
+
+    for (int unit = beginUnit; unit < endUnit; unit++)
+    {
+        float* a = data + 2 * start;
+        float* b = data + 2 * (start + half);
+
+        const float wr = twiddles[static_cast<size_t> (2 * k * twiddleStride)];
+        const float wi = conjugate * twiddles[static_cast<size_t> (2 * k * twiddleStride + 1)];
+
+        const float br = b[2 * k];
+        const float bi = b[2 * k + 1];
+        const float tr = br * wr - bi * wi;
+        const float ti = br * wi + bi * wr;
+
+        const float ar = a[2 * k];
+        const float ai = a[2 * k + 1];
+        a[2 * k] = ar + tr;
+        a[2 * k + 1] = ai + ti;
+        b[2 * k] = ar - tr;
+        b[2 * k + 1] = ai - ti;
+
+        if (++k == half)
+        {
+            k = 0;
+            start += 2 * half;
+        }
+    }
+}
+
+//==============================================================================
+// The real transforms pack even samples into the real parts and odd samples
+// into the imaginary parts of a half-size complex transform, then untangle the
+// two spectra, X[k] = E[k] + W^k O[k], pairing bin k with bin M - k.
+void Fft::performFrequencyOnlyForwardTransform (float* data) const
+{
+    for (int pass = 0; pass < getNumForwardPasses(); pass++)
+        performForwardPass (data, pass, 0, getPassLength());
+}
+
+void Fft::performRealOnlyInverseTransform (float* data) const
+{
+    for (int pass = 0; pass < getNumInversePasses(); pass++)
+        performInversePass (data, pass, 0, getPassLength());
+}
+
+void Fft::performForwardPass (float* data, int pass, int beginUnit, int endUnit) const
+{
+    if (pass == 0)                       bitReverse (data, beginUnit, endUnit);
+    else if (pass <= complexOrder)       butterflies (data, 1 << (pass - 1), false, beginUnit, endUnit);
+    else if (pass == complexOrder + 1)   untangleForward (data, beginUnit, endUnit);
+    else                                 takeMagnitudes (data, beginUnit, endUnit);
+}
+
+void Fft::performInversePass (float* data, int pass, int beginUnit, int endUnit) const
+{
+    if (pass == 0)                       untangleInverse (data, beginUnit, endUnit);
+    else if (pass == 1)                  bitReverse (data, beginUnit, endUnit);
+    else                                 butterflies (data, 1 << (pass - 2), true, beginUnit, endUnit);
+}
+
+void Fft::performComplexPass (float* data, bool inverse, int pass, int beginUnit, int endUnit) const
+{
+    if (pass == 0)                       bitReverse (data, beginUnit, endUnit);
+    else                                 butterflies (data, 1 << (pass - 1), inverse, beginUnit, endUnit);
+}
+
+// each unit untangles bins k and M - k, with k = unit + 1
+void Fft::untangleForward (float* data, int beginUnit, int endUnit) const
+{
+    const int m = complexSize;
+
+    // DC & Nyquist
+    if (beginUnit == 0)
+    {
+        const float z0r = data[0];
+        const float z0i = data[1];
+        data[0] = z0r + z0i;
+        data[1] = 0.0f;
+        data[2 * m] = z0r - z0i;
+        data[2 * m + 1] = 0.0f;
+    }
+
+    for (int k = beginUnit + 1; k <= endUnit; k++)
+    {
+        const float zkr = data[2 * k];
+        const float zki = data[2 * k + 1];
+        const float zmr = data[2 * (m - k)];
+        const float zmi = data[2 * (m - k) + 1];
+
+        // E = (Z[k] + conj Z[M-k]) / 2, O = (Z[k] - conj Z[M-k]) / 2i
+        const float er = 0.5f * (zkr + zmr);
+        const float ei = 0.5f * (zki - zmi);
+        const float or_ = 0.5f * (zki + zmi);
+        const float oi = -0.5f * (zkr - zmr);
+
+        const float wr = realTwiddles[static_cast<size_t> (2 * k)];
+        const float wi = realTwiddles[static_cast<size_t> (2 * k + 1)];
+        const float tr = or_ * wr - oi * wi;
+        const float ti = or_ * wi + oi * wr;
+
+        // X[k] = E + W^k O and X[M-k] = conj (E - W^k O)
+        data[2 * k] = er + tr;
+        data[2 * k + 1] = ei + ti;
+        data[2 * (m - k)] = er - tr;
+        data[2 * (m - k) + 1] = ti - ei;
+    }
+}
+
+// each unit takes the magnitudes of two bins, and the last one the Nyquist bin too
+void Fft::takeMagnitudes (float* data, int beginUnit, int endUnit) const
+{
+    const int endBin = endUnit == getPassLength() ? complexSize + 1 : 2 * endUnit;
+
+    // bin k moves down to index k, whose old contents have already been read
+    for (int k = 2 * beginUnit; k < endBin; k++)
+    {
+        const float re = data[2 * k];
+        const float im = data[2 * k + 1];
+        data[k] = std::sqrt (re * re + im * im);
+    }
+}
+
+// each unit untangles bins k and M - k, with k = unit + 1
+void Fft::untangleInverse (float* data, int beginUnit, int endUnit) const
+{
+    const int m = complexSize;
+    const float scale = 0.5f / static_cast<float> (m);
+
+    // DC & Nyquist
+    if (beginUnit == 0)
+    {
+        const float x0 = data[0];
+        const float xm = data[2 * m];
+        data[0] = scale * (x0 + xm);
+        data[1] = scale * (x0 - xm);
+    }
+
+    for (int k = beginUnit + 1; k <= endUnit; k++)
+    {
+        const float xkr = data[2 * k];
+        const float xki = data[2 * k + 1];
+        const float xmr = data[2 * (m - k)];
+        const float xmi = data[2 * (m - k) + 1];
+
+        // E = (X[k] + conj X[M-k]) / 2, O = (X[k] - conj X[M-k]) conj (W^k) / 2
+        const float er = scale * (xkr + xmr);
+        const float ei = scale * (xki - xmi);
+        const float dr = scale * (xkr - xmr);
+        const float di = scale * (xki + xmi);
+
+        const float wr = realTwiddles[static_cast<size_t> (2 * k)];
+        const float wi = -realTwiddles[static_cast<size_t> (2 * k + 1)];
+        const float or_ = dr * wr - di * wi;
+        const float oi = dr * wi + di * wr;
+
+        // Z[k] = E + iO and Z[M-k] = conj E + i conj O
+        data[2 * k] = er - oi;
+        data[2 * k + 1] = ei + or_;
+        data[2 * (m - k)] = er + oi;
+        data[2 * (m - k) + 1] = or_ - ei;
+    }
+}
@@ -0,0 +1,69 @@
+/*
+  ==============================================================================
+
+    Fft.h
+
+    Radix-2 real FFT for the engine. The data layouts and scaling match
+    juce::dsp::FFT, so the two can be swapped without touching callers.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <vector>
+
+//==============================================================================
+/**
+*/
+class Fft
+{
+public:
+    explicit Fft (int order);
+
+    int getSize() const { return size; }
+
+    // data holds 2 * getSize() floats. On input the first getSize() are real
+    // samples, on output the first getSize() / 2 + 1 are bin magnitudes.
+    void performFrequencyOnlyForwardTransform (float* data) const;
+
+    // data holds 2 * getSize() floats. On input the first getSize() / 2 + 1
+    // interleaved complex values are the spectrum, on output the first
+    // getSize() floats are the real signal, scaled by 1 / getSize().
+    void performRealOnlyInverseTransform (float* data) const;
+
+    //==============================================================================
+    // Both transforms can also be run a pass at a time, so that one transform
+    // can be spread over several calls. Every pass is split into
+    // getPassLength() units of work, and running every unit of every pass in
+    // order gives exactly the same result as the whole transform.
+    int getNumForwardPasses() const { return complexOrder + 3; }
+    int getNumInversePasses() const { return complexOrder + 2; }
+    int getPassLength() const { return complexSize / 2; }
+
+    void performForwardPass (float* data, int pass, int beginUnit, int endUnit) const;
+    void performInversePass (float* data, int pass, int beginUnit, int endUnit) const;
+
+    // The getSize() / 2 point complex transform underneath, unscaled, on
+    // interleaved data. Passes split into getPassLength() units as above.
+    void performComplexTransform (float* data, bool inverse) const { performComplex (data, inverse); }
+    int getNumComplexPasses() const { return complexOrder + 1; }
+    void performComplexPass (float* data, bool inverse, int pass, int beginUnit, int endUnit) const;
+
+private:
+    // in-place complex FFT of getSize() / 2 interleaved points, unscaled
+    void performComplex (float* data, bool inverse) const;
+
+    void bitReverse (float* data, int beginUnit, int endUnit) const;
+    void butterflies (float* data, int half, bool inverse, int beginUnit, int endUnit) const;
+    void untangleForward (float* data, int beginUnit, int endUnit) const;
+    void takeMagnitudes (float* data, int beginUnit, int endUnit) const;
+    void untangleInverse (float* data, int beginUnit, int endUnit) const;
+
+    int size;
+    int complexOrder;
+    int complexSize;
+    std::vector<int> bitReversed;
+    std::vector<float> twiddles;     // e^(-2 pi i k / complexSize), interleaved
+    std::vector<float> realTwiddles; // e^(-2 pi i k / size), interleaved
+};
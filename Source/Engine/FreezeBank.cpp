@@ -0,0 +1,142 @@
+/*
+  ==============================================================================
+
+    FreezeBank.cpp
+
+  ==============================================================================
+*/
+
+#include "FreezeBank.h"
+
+//==============================================================================
+namespace
+{
+    // little endian, like the snapshots themselves
+    void writeUint32 (std::vector<std::uint8_t>& dest, std::uint32_t value)
+    {
+        for (int shift = 0; shift < 32; shift += 8)
+            dest.push_back (static_cast<std::uint8_t> (value >> shift));
+    }
+
+    std::uint32_t readUint32 (const std::uint8_t* source)
+    {
+        return static_cast<std::uint32_t> (source[0])
+             | (static_cast<std::uint32_t> (source[1]) << 8)
+             | (static_cast<std::uint32_t> (source[2]) << 16)
+             | (static_cast<std::uint32_t> (source[3]) << 24);
+    }
+}
+
+//==============================================================================
+FreezeBank::~FreezeBank()
+{
+    close();
+}
+
+bool FreezeBank::open (const void* data, std::size_t numBytes, RecallCallback onRecall)
+{
+    close();
+
+    const auto* bytes = static_cast<const std::uint8_t*> (data);
+
+    if (bytes == nullptr || numBytes < static_cast<std::size_t> (headerBytes) || readUint32 (bytes) != magic)
+        return false;
+
+    const auto dataVersion = static_cast<int> (readUint32 (bytes + 4));
+    const auto count = readUint32 (bytes + 8);
+
+    if (dataVersion < 1 || dataVersion > version || count > static_cast<std::uint32_t> (maxNumSnapshots)
+        || numBytes < headerBytes + static_cast<std::size_t> (count) * indexEntryBytes)
+        return false;
+
+    // every snapshot has to lie inside the bank
+    for (std::uint32_t index = 0; index < count; index++)
+    {
+        const std::uint8_t* entry = bytes + headerBytes + index * indexEntryBytes;
+        const std::size_t offset = readUint32 (entry);
+        const std::size_t size = readUint32 (entry + 4);
+
+        if (offset > numBytes || size > numBytes - offset)
+            return false;
+    }
+
+    bankData = bytes;
+    bankBytes = numBytes;
+    recallCallback = std::move (onRecall);
+    requestedSnapshot = noSnapshot;
+    numSnapshots = static_cast<int> (count);
+
+    loaderShouldExit = false;
+    loader = std::thread ([this] { run(); });
+    return true;
+}
+
+void FreezeBank::close()
+{
+    if (loader.joinable())
+    {
+        loaderShouldExit = true;
+        loaderWakeup.signal();
+        loader.join();
+    }
+
+    numSnapshots = 0;
+    bankData = nullptr;
+    bankBytes = 0;
+    recallCallback = nullptr;
+}
+
+//==============================================================================
+void FreezeBank::recall (int index)
+{
+    if (index >= 0 && index < numSnapshots.load())
+    {
+        requestedSnapshot = index;
+        loaderWakeup.signal();
+    }
+}
+
+bool FreezeBank::getSnapshot (int index, const void*& snapshotData, std::size_t& numBytes) const
+{
+    if (index < 0 || index >= numSnapshots.load())
+        return false;
+
+    const std::uint8_t* entry = bankData + headerBytes + static_cast<std::size_t> (index) * indexEntryBytes;
+    snapshotData = bankData + readUint32 (entry);
+    numBytes = readUint32 (entry + 4);
+    return true;
+}
+
+void FreezeBank::writeIndex (const std::vector<std::size_t>& snapshotSizes, std::vector<std::uint8_t>& destData)
+{
+    destData.clear();
+    writeUint32 (destData, magic);
+    writeUint32 (destData, version);
+    writeUint32 (destData, static_cast<std::uint32_t> (snapshotSizes.size()));
+
+    std::size_t offset = headerBytes + snapshotSizes.size() * indexEntryBytes;
+
+    for (const auto size : snapshotSizes)
+    {
+        writeUint32 (destData, static_cast<std::uint32_t> (offset));
+        writeUint32 (destData, static_cast<std::uint32_t> (size));
+        offset += size;
+    }
+}
+
+//==============================================================================
+void FreezeBank::run()
+{
+    while (! loaderShouldExit)
+    {
+        // only the most recent request matters, earlier ones are skipped
+        const int index = requestedSnapshot.exchange (noSnapshot);
+        const void* snapshotData;
+        std::size_t numBytes;
+
+        if (index != noSnapshot && getSnapshot (index, snapshotData, numBytes))
+            recallCallback (snapshotData, numBytes);
+
+        loaderWakeup.wait();
+    }
+}
@@ -0,0 +1,84 @@
+/*
+  ==============================================================================
+
+    FreezeBank.h
+
+    A bank of freeze snapshots in one block of bytes, usually a memory mapped
+    file, so that hundreds of them cost no more memory than the ones being
+    recalled. Each snapshot is a FreezeState in its binary form, found through
+    an index at the start of the bank. A loader thread, woken by each recall,
+    reads the snapshot out of the bank, so the audio thread never touches the
+    file.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Semaphore.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+//==============================================================================
+/**
+*/
+class FreezeBank
+{
+public:
+    using RecallCallback = std::function<void (const void* snapshotData, std::size_t numBytes)>;
+
+    static constexpr std::uint32_t magic = 0x6b624641;   // "AFbk"
+    static constexpr int version = 1;
+    static constexpr int maxNumSnapshots = 1024;
+
+    //==============================================================================
+    FreezeBank() = default;
+    ~FreezeBank();
+
+    // Checks the index and starts the loader thread, which hands each recalled
+    // snapshot to onRecall. The bytes aren't copied, so they must outlive the
+    // bank, or the next call to open or close.
+    bool open (const void* data, std::size_t numBytes, RecallCallback onRecall);
+    void close();
+
+    // any thread
+    int getNumSnapshots() const { return numSnapshots.load(); }
+
+    // any thread and real-time safe, the snapshot is loaded in the background
+    void recall (int index);
+
+    // the snapshot's bytes in the bank, from any thread but the audio thread
+    bool getSnapshot (int index, const void*& snapshotData, std::size_t& numBytes) const;
+
+    //==============================================================================
+    // the header and index for a bank of snapshots of these sizes, which
+    // are then written after it in the same order
+    static void writeIndex (const std::vector<std::size_t>& snapshotSizes, std::vector<std::uint8_t>& destData);
+
+private:
+    //==============================================================================
+    void run();
+
+    static constexpr int headerBytes = 12;
+    static constexpr int indexEntryBytes = 8;
+    static constexpr int noSnapshot = -1;
+
+    const std::uint8_t* bankData = nullptr;
+    std::size_t bankBytes = 0;
+    std::atomic<int> numSnapshots { 0 };
+    RecallCallback recallCallback;
+
+    std::atomic<int> requestedSnapshot { noSnapshot };
+    std::thread loader;
+    Semaphore loaderWakeup;
+    std::atomic<bool> loaderShouldExit { false };
+
+    //==============================================================================
+    FreezeBank (const FreezeBank&) = delete;
+    FreezeBank& operator= (const FreezeBank&) = delete;
+};
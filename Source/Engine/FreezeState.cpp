@@ -0,0 +1,224 @@
+/*
+  ==============================================================================
+
+    FreezeState.cpp
+
+  ==============================================================================
+*/
+
+#include "FreezeState.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+//==============================================================================
+namespace
+{
+    // everything is stored little endian, whatever the platform
+    void writeUint16 (std::vector<std::uint8_t>& dest, std::uint32_t value)
+    {
+        dest.push_back (static_cast<std::uint8_t> (value));
+        dest.push_back (static_cast<std::uint8_t> (value >> 8));
+    }
+
+    void writeUint32 (std::vector<std::uint8_t>& dest, std::uint32_t value)
+    {
+        writeUint16 (dest, value & 0xffff);
+        writeUint16 (dest, value >> 16);
+    }
+
+    void writeFloat (std::vector<std::uint8_t>& dest, float value)
+    {
+        std::uint32_t bits;
+        std::memcpy (&bits, &value, sizeof (bits));
+        writeUint32 (dest, bits);
+    }
+
+    std::uint32_t readUint16 (const std::uint8_t* source)
+    {
+        return static_cast<std::uint32_t> (source[0]) | (static_cast<std::uint32_t> (source[1]) << 8);
+    }
+
+    std::uint32_t readUint32 (const std::uint8_t* source)
+    {
+        return readUint16 (source) | (readUint16 (source + 2) << 16);
+    }
+
+    // anything that can't be a magnitude or a gain reads back as silence
+    float readFloat (const std::uint8_t* source)
+    {
+        const std::uint32_t bits = readUint32 (source);
+        float value;
+        std::memcpy (&value, &bits, sizeof (value));
+        return std::isfinite (value) && value > 0.0f ? value : 0.0f;
+    }
+
+    float getPeak (const float* mags, int numBins)
+    {
+        float peak = 0.0f;
+
+        for (int bin = 0; bin < numBins; bin++)
+            peak = std::max (peak, mags[bin]);
+
+        return peak;
+    }
+}
+
+//==============================================================================
+void FreezeState::setSize (int newNumChannels, int maxNumBins)
+{
+    mags.setSize (newNumChannels, maxNumBins);
+    gains.assign (static_cast<size_t> (newNumChannels), 1.0f);
+    numChannels = newNumChannels;
+    fftOrder = 0;
+}
+
+void FreezeState::copyFrom (const SampleBuffer& source, int newFftOrder, ChannelMode newMode, const float* channelGains)
+{
+    fftOrder = newFftOrder;
+    mode = newMode;
+    numChannels = std::min (source.getNumChannels(), mags.getNumChannels());
+
+    if (getNumBins() > mags.getNumSamples())
+    {
+        // too big for the state, which would only happen if it wasn't prepared for it
+        fftOrder = 0;
+        return;
+    }
+
+    for (int channel = 0; channel < getNumMagnitudeChannels(); channel++)
+        mags.copyFrom (channel, 0, source.getReadPointer (channel), getNumBins());
+
+    for (int channel = 0; channel < numChannels; channel++)
+        gains[static_cast<size_t> (channel)] = channelGains != nullptr ? channelGains[channel] : 1.0f;
+}
+
+//==============================================================================
+void FreezeState::toBinary (Encoding encoding, std::vector<std::uint8_t>& destData) const
+{
+    const int numBins = getNumBins();
+    const int bytesPerBin = encoding == Encoding::Float32 ? 4 : 2;
+
+    destData.clear();
+    destData.reserve (static_cast<size_t> (headerBytes + 4 * numChannels
+                                           + getNumMagnitudeChannels() * (4 + bytesPerBin * numBins)));
+
+    writeUint32 (destData, magic);
+    writeUint16 (destData, version);
+    destData.push_back (static_cast<std::uint8_t> (encoding));
+    destData.push_back (static_cast<std::uint8_t> (mode));
+    destData.push_back (static_cast<std::uint8_t> (fftOrder));
+    destData.push_back (static_cast<std::uint8_t> (numChannels));
+    writeUint16 (destData, 0);
+
+    for (int channel = 0; channel < numChannels; channel++)
+        writeFloat (destData, getGain (channel));
+
+    for (int channel = 0; channel < getNumMagnitudeChannels(); channel++)
+    {
+        const float* channelMags = getMagnitudes (channel);
+
+        if (encoding == Encoding::Float32)
+        {
+            for (int bin = 0; bin < numBins; bin++)
+                writeFloat (destData, channelMags[bin]);
+
+            continue;
+        }
+
+        // the quantised encodings are relative to the loudest bin
+        const float peak = getPeak (channelMags, numBins);
+        writeFloat (destData, peak);
+
+        for (int bin = 0; bin < numBins; bin++)
+        {
+            const float ratio = peak > 0.0f ? channelMags[bin] / peak : 0.0f;
+            long code = 0;
+
+            if (encoding == Encoding::Linear16)
+            {
+                code = std::lround (ratio * 65535.0f);
+            }
+            else if (ratio > 0.0f)
+            {
+                // 0 is silence, 1 is logRangeDb down and 65535 is the peak
+                const float db = 20.0f * std::log10 (ratio);
+                code = db < -logRangeDb ? 0 : 65535 + std::lround (db * (65534.0f / logRangeDb));
+            }
+
+            writeUint16 (destData, static_cast<std::uint32_t> (std::clamp (code, 0L, 65535L)));
+        }
+    }
+}
+
+bool FreezeState::fromBinary (const void* data, std::size_t numBytes)
+{
+    const auto* bytes = static_cast<const std::uint8_t*> (data);
+    fftOrder = 0;
+
+    if (bytes == nullptr || numBytes < static_cast<std::size_t> (headerBytes) || readUint32 (bytes) != magic)
+        return false;
+
+    const int dataVersion = static_cast<int> (readUint16 (bytes + 4));
+    const int encodingIndex = bytes[6];
+    const int modeIndex = bytes[7];
+    const int newFftOrder = bytes[8];
+    const int newNumChannels = bytes[9];
+
+    if (dataVersion < 1 || dataVersion > version
+        || encodingIndex > static_cast<int> (Encoding::Log16)
+        || modeIndex > static_cast<int> (ChannelMode::MidSide)
+        || newFftOrder < 1 || newFftOrder > maxFftOrder
+        || newNumChannels < 1 || newNumChannels > SampleBlock::maxChannels)
+        return false;
+
+    const auto encoding = static_cast<Encoding> (encodingIndex);
+    const auto newMode = static_cast<ChannelMode> (modeIndex);
+    const int numBins = (1 << newFftOrder) / 2 + 1;
+    const int numMagnitudeChannels = newMode == ChannelMode::MidSide ? 1 : newNumChannels;
+    const std::size_t channelBytes = encoding == Encoding::Float32 ? 4 * static_cast<std::size_t> (numBins)
+                                                                   : 4 + 2 * static_cast<std::size_t> (numBins);
+
+    if (numBytes < headerBytes + 4 * static_cast<std::size_t> (newNumChannels) + numMagnitudeChannels * channelBytes)
+        return false;
+
+    if (mags.getNumChannels() < newNumChannels || mags.getNumSamples() < numBins)
+        setSize (newNumChannels, numBins);
+
+    const std::uint8_t* source = bytes + headerBytes;
+
+    for (int channel = 0; channel < newNumChannels; channel++, source += 4)
+        gains[static_cast<size_t> (channel)] = readFloat (source);
+
+    for (int channel = 0; channel < numMagnitudeChannels; channel++)
+    {
+        float* channelMags = mags.getWritePointer (channel);
+
+        if (encoding == Encoding::Float32)
+        {
+            for (int bin = 0; bin < numBins; bin++, source += 4)
+                channelMags[bin] = readFloat (source);
+
+            continue;
+        }
+
+        const float peak = readFloat (source);
+        source += 4;
+
+        for (int bin = 0; bin < numBins; bin++, source += 2)
+        {
+            const auto code = static_cast<float> (readUint16 (source));
+
+            if (encoding == Encoding::Linear16)
+                channelMags[bin] = peak * (code / 65535.0f);
+            else
+                channelMags[bin] = code > 0.0f ? peak * std::pow (10.0f, (code - 65535.0f) * (logRangeDb / 65534.0f) / 20.0f) : 0.0f;
+        }
+    }
+
+    mode = newMode;
+    numChannels = newNumChannels;
+    fftOrder = newFftOrder;
+    return true;
+}
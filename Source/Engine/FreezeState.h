@@ -0,0 +1,73 @@
+/*
+  ==============================================================================
+
+    FreezeState.h
+
+    A captured freeze spectrum, the magnitudes the grains are resynthesised
+    from, and its compact binary form for saving with a session. Only the
+    bins up to Nyquist are kept, and only the mid channel in mid/side mode,
+    optionally quantised to 16 bits on a linear or a log scale.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "GrainPool.h"
+#include "SampleBuffer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//==============================================================================
+/**
+*/
+class FreezeState
+{
+public:
+    enum class Encoding : std::uint8_t
+    {
+        Float32,    // exact
+        Linear16,   // 16 bits scaled to each channel's loudest bin
+        Log16       // 16 bits over the top 144 dB of each channel
+    };
+
+    static constexpr std::uint32_t magic = 0x7a724641;   // "AFrz"
+    static constexpr int version = 1;
+
+    //==============================================================================
+    // allocates, so call this while audio isn't running
+    void setSize (int numChannels, int maxNumBins);
+
+    // real-time safe as long as the state was sized for the spectrum
+    void copyFrom (const SampleBuffer& mags, int fftOrder, ChannelMode mode, const float* channelGains);
+    void clear() { fftOrder = 0; }
+
+    bool isEmpty() const { return fftOrder == 0; }
+    int getFftOrder() const { return fftOrder; }
+    ChannelMode getMode() const { return mode; }
+    int getNumChannels() const { return numChannels; }
+    int getNumBins() const { return (1 << fftOrder) / 2 + 1; }
+
+    // mid/side states only hold the mid magnitudes, in channel 0
+    int getNumMagnitudeChannels() const { return mode == ChannelMode::MidSide ? 1 : numChannels; }
+    const float* getMagnitudes (int channel) const { return mags.getReadPointer (channel); }
+    float getGain (int channel) const { return gains[static_cast<size_t> (channel)]; }
+
+    //==============================================================================
+    // both allocate, and fromBinary leaves the state empty if the data isn't valid
+    void toBinary (Encoding encoding, std::vector<std::uint8_t>& destData) const;
+    bool fromBinary (const void* data, std::size_t numBytes);
+
+private:
+    static constexpr int headerBytes = 12;
+    static constexpr int maxFftOrder = 24;
+    static constexpr float logRangeDb = 144.0f;
+
+    int fftOrder = 0;
+    ChannelMode mode = ChannelMode::Independent;
+    int numChannels = 0;
+    SampleBuffer mags;
+    std::vector<float> gains;
+};
@@ -0,0 +1,145 @@
+/*
+  ==============================================================================
+
+    GrainBuffer.h
+
+    Multichannel storage for resynthesised grains, as 32 bit floats or, to
+    halve their footprint, as 16 bit IEEE half floats. Grains are written a
+    run of floats at a time and read back by the overlap-add, which converts
+    half floats as it goes.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+//==============================================================================
+/**
+*/
+class GrainBuffer
+{
+public:
+    enum class Format
+    {
+        Float32,
+        Float16     // 11 bits of precision, about 66 dB below each sample
+    };
+
+    GrainBuffer() = default;
+
+    GrainBuffer (const GrainBuffer&) = delete;
+    GrainBuffer& operator= (const GrainBuffer&) = delete;
+
+    // allocates, so never call this from the audio thread
+    void setSize (int newNumChannels, int newNumSamples, Format newFormat)
+    {
+        numChannels = newNumChannels;
+        numSamples = newNumSamples;
+        format = newFormat;
+
+        const auto totalSamples = static_cast<size_t> (numChannels) * static_cast<size_t> (numSamples);
+        floats.assign (format == Format::Float32 ? totalSamples : 0, 0.0f);
+        halves.assign (format == Format::Float16 ? totalSamples : 0, 0);
+    }
+
+    int getNumChannels() const { return numChannels; }
+    int getNumSamples() const { return numSamples; }
+    Format getFormat() const { return format; }
+    std::size_t getNumBytes() const { return floats.size() * sizeof (float) + halves.size() * sizeof (std::uint16_t); }
+
+    // only the pointers for the buffer's own format are valid
+    const float* getFloatPointer (int channel) const { return floats.data() + getOffset (channel); }
+    const std::uint16_t* getHalfPointer (int channel) const { return halves.data() + getOffset (channel); }
+
+    float getSample (int channel, int sample) const
+    {
+        return format == Format::Float32 ? getFloatPointer (channel)[sample] : halfToFloat (getHalfPointer (channel)[sample]);
+    }
+
+    // grain[startSample + i] = gain * source[i * stride]
+    void write (int channel, int startSample, const float* source, int numSamplesToWrite, float gain = 1.0f, int stride = 1)
+    {
+        if (format == Format::Float32)
+        {
+            float* dest = floats.data() + getOffset (channel) + startSample;
+
+            for (int i = 0; i < numSamplesToWrite; i++)
+                dest[i] = gain * source[i * stride];
+
+            return;
+        }
+
+        std::uint16_t* dest = halves.data() + getOffset (channel) + startSample;
+
+        for (int i = 0; i < numSamplesToWrite; i++)
+            dest[i] = floatToHalf (gain * source[i * stride]);
+    }
+
+    void clear()
+    {
+        std::fill (floats.begin(), floats.end(), 0.0f);
+        std::fill (halves.begin(), halves.end(), std::uint16_t (0));
+    }
+
+    //==============================================================================
+    // Rounds to the nearest half float, and clamps anything too loud for one
+    // to the largest, 65504, rather than letting it become infinite.
+    static std::uint16_t floatToHalf (float value)
+    {
+        std::uint32_t bits;
+        std::memcpy (&bits, &value, sizeof (bits));
+
+        const auto sign = static_cast<std::uint16_t> ((bits >> 16) & 0x8000);
+        bits &= 0x7fffffff;
+
+        if (bits >= 0x477ff000)
+            return static_cast<std::uint16_t> (sign | 0x7bff);
+
+        // below 2^-14 a half float is denormal, in steps of 2^-24
+        if (bits < 0x38800000)
+        {
+            float magnitude;
+            std::memcpy (&magnitude, &bits, sizeof (magnitude));
+            return static_cast<std::uint16_t> (sign | static_cast<std::uint16_t> (magnitude * 16777216.0f + 0.5f));
+        }
+
+        // rebias the exponent and round the mantissa to nearest even
+        bits -= 0x38000000;
+        return static_cast<std::uint16_t> (sign | ((bits + 0x0fff + ((bits >> 13) & 1)) >> 13));
+    }
+
+    // The same bit trick as the vectorised conversion in the overlap-add.
+    // Denormal half floats, below about -84 dB, read as zero wherever the
+    // CPU flushes denormals.
+    static float halfToFloat (std::uint16_t half)
+    {
+        const std::uint32_t sign = static_cast<std::uint32_t> (half & 0x8000) << 16;
+        const std::uint32_t magnitudeBits = static_cast<std::uint32_t> (half & 0x7fff) << 13;
+        float magnitude;
+        std::memcpy (&magnitude, &magnitudeBits, sizeof (magnitude));
+
+        magnitude *= 5.192296858534828e33f;   // 2^112
+        std::uint32_t bits;
+        std::memcpy (&bits, &magnitude, sizeof (bits));
+        bits |= sign;
+
+        float value;
+        std::memcpy (&value, &bits, sizeof (value));
+        return value;
+    }
+
+private:
+    size_t getOffset (int channel) const { return static_cast<size_t> (channel) * static_cast<size_t> (numSamples); }
+
+    std::vector<float> floats;
+    std::vector<std::uint16_t> halves;
+    int numChannels = 0;
+    int numSamples = 0;
+    Format format = Format::Float32;
+};
@@ -0,0 +1,243 @@
+/*
+  ==============================================================================
+
+    GrainPool.cpp
+
+  ==============================================================================
+*/
+
+#include "GrainPool.h"
+
+#include <chrono>
+#include <random>
+#include <thread>
+
+//==============================================================================
+GrainPool::GrainPool()
+    : seed ((static_cast<std::uint64_t> (std::random_device{}()) << 32) | std::random_device{}())
+{
+}
+
+//==============================================================================
+std::size_t GrainPool::getMemoryUsage (int numChannels, int maxFftOrder, int numActive, int numSpare, GrainBuffer::Format format)
+{
+    const std::size_t grainSamples = std::size_t (1) << maxFftOrder;
+    const std::size_t bytesPerSample = format == GrainBuffer::Format::Float16 ? 2 : 4;
+    const auto numGrainBuffers = static_cast<std::size_t> (numActive + numSpare);
+
+    // the spectrum triple buffer holds half spectra, the worker's scratch
+    // belongs to the engine
+    return static_cast<std::size_t> (numChannels) * grainSamples * (numGrainBuffers * bytesPerSample + 3 * sizeof (float) / 2);
+}
+
+void GrainPool::prepare (GrainWorker& workerToWake, int numChannels, int minFftOrder, int maxFftOrder, int numActive, int numSpare,
+                         GrainBuffer::Format format)
+{
+    worker = &workerToWake;
+
+    // every grain is big enough for the largest size
+    const int grainSamples = 1 << maxFftOrder;
+    numActiveGrains = numActive;
+    const int totalGrains = numActiveGrains + numSpare;
+
+    grainStorage.clear();
+
+    for (int i = 0; i < totalGrains; i++)
+    {
+        auto grain = std::make_unique<Grain>();
+        grain->buffer.setSize (numChannels, grainSamples, format);
+        grainStorage.push_back (std::move (grain));
+    }
+
+    activeGrains.resize (static_cast<size_t> (numActiveGrains));
+
+    for (int i = 0; i < numActiveGrains; i++)
+        activeGrains[static_cast<size_t> (i)] = grainStorage[static_cast<size_t> (i)].get();
+
+    // both fifos must be able to hold every grain at once
+    freeGrains.reset (totalGrains);
+    readyGrains.reset (totalGrains);
+
+    // the spares start out silent, which matches the silent initial spectrum
+    for (int i = numActiveGrains; i < totalGrains; i++)
+        readyGrains.push (grainStorage[static_cast<size_t> (i)].get());
+
+    // only the bins up to Nyquist are kept
+    for (auto& spectrum : spectra)
+        spectrum.setSize (numChannels, grainSamples / 2 + 1);
+
+    for (auto& gains : spectrumGains)
+        gains.assign (static_cast<size_t> (numChannels), 1.0f);
+
+    spectrumGenerations.fill (0);
+    spectrumOrders.fill (maxFftOrder);
+    spectrumModes.fill (ChannelMode::Independent);
+    spectrumBackIndex = 0;
+    spectrumExchange = 1;
+    spectrumFrontIndex = 2;
+    audioGeneration = 0;
+
+    minOrder = minFftOrder;
+    workerFfts.clear();
+    workerPairFfts.clear();
+
+    for (int order = minFftOrder; order <= maxFftOrder; order++)
+    {
+        workerFfts.push_back (SharedTables::getFft (order));
+        workerPairFfts.push_back (SharedTables::getFft (order + 1));
+    }
+
+    workerSerial = 0;
+    numUnderruns = 0;
+    numRenewals = 0;
+}
+
+//==============================================================================
+void GrainPool::publishSpectrum (const SampleBuffer& mags, int fftOrder, ChannelMode mode, const float* channelGains)
+{
+    const auto back = static_cast<size_t> (spectrumBackIndex);
+    auto& spectrum = spectra[back];
+
+    // shared magnitudes only live in the first channel
+    const int numChannelsToCopy = mode == ChannelMode::MidSide ? 1 : spectrum.getNumChannels();
+    const int numBins = (1 << fftOrder) / 2 + 1;
+
+    for (int channel = 0; channel < numChannelsToCopy; channel++)
+        spectrum.copyFrom (channel, 0, mags.getReadPointer (channel), numBins);
+
+    if (channelGains != nullptr)
+        std::copy (channelGains, channelGains + spectrumGains[back].size(), spectrumGains[back].begin());
+
+    spectrumModes[back] = mode;
+    spectrumOrders[back] = fftOrder;
+
+    spectrumGenerations[static_cast<size_t> (spectrumBackIndex)] = ++audioGeneration;
+    spectrumBackIndex = spectrumExchange.exchange (spectrumBackIndex | spectrumDirtyFlag) & spectrumIndexMask;
+    worker->wake();
+}
+
+GrainPool::Grain* GrainPool::popReadyGrain()
+{
+    Grain* candidate;
+
+    // grains rendered from an older spectrum go straight back to the worker
+    while (readyGrains.pop (candidate))
+    {
+        if (candidate->generation == audioGeneration)
+            return candidate;
+
+        freeGrains.push (candidate);
+        worker->wake();
+    }
+
+    return nullptr;
+}
+
+bool GrainPool::renewActiveGrain (int index, bool waitForWorker)
+{
+    Grain* freshGrain = popReadyGrain();
+
+    // offline renders may block, which keeps seeded renders reproducible
+    if (freshGrain == nullptr && waitForWorker)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds (maxWorkerWaitMs);
+
+        while (freshGrain == nullptr && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::yield();
+            freshGrain = popReadyGrain();
+        }
+    }
+
+    if (freshGrain == nullptr)
+    {
+        // nothing ready in time, so the spent grain is replayed rather than going silent
+        numUnderruns++;
+        return false;
+    }
+
+    auto& activeGrain = activeGrains[static_cast<size_t> (index)];
+    freeGrains.push (activeGrain);
+    worker->wake();
+    activeGrain = freshGrain;
+    numRenewals++;
+    return true;
+}
+
+//==============================================================================
+bool GrainPool::pullLatestSpectrum()
+{
+    if ((spectrumExchange.load() & spectrumDirtyFlag) == 0)
+        return false;
+
+    spectrumFrontIndex = spectrumExchange.exchange (spectrumFrontIndex) & spectrumIndexMask;
+    return true;
+}
+
+bool GrainPool::synthesiseFreeGrain (std::vector<float>& fftData, RandomPhaseSpectrum& phases)
+{
+    // the audio thread synthesises the first numActiveGrains serials itself
+    if (pullLatestSpectrum())
+        workerSerial = static_cast<std::uint64_t> (numActiveGrains);
+
+    Grain* grain;
+
+    if (! freeGrains.pop (grain))
+        return false;
+
+    const auto front = static_cast<size_t> (spectrumFrontIndex);
+    const auto generation = spectrumGenerations[front];
+    const auto fftIndex = static_cast<size_t> (spectrumOrders[front] - minOrder);
+    const auto& fft = *workerFfts[fftIndex];
+
+    phases.setNumBins (fft.getSize() / 2);
+    phases.randomise (seed.load(), generation, workerSerial++);
+    synthesise (spectra[front], spectrumModes[front], spectrumGains[front].data(), grain->buffer,
+                fft, *workerPairFfts[fftIndex], fftData, phases);
+    grain->generation = generation;
+
+    readyGrains.push (grain);
+    return true;
+}
+
+//==============================================================================
+void GrainPool::synthesise (const SampleBuffer& mags, ChannelMode mode, const float* channelGains, GrainBuffer& grain,
+                            const Fft& fft, const Fft& pairFft, std::vector<float>& fftData, const RandomPhaseSpectrum& phases)
+{
+    const int numChannels = grain.getNumChannels();
+    const int grainSamples = fft.getSize();
+
+    // every channel shares the same phases so the stereo image holds together
+    if (mode == ChannelMode::MidSide)
+    {
+        phases.toCartesian (mags.getReadPointer (0), fftData.data());
+        fft.performRealOnlyInverseTransform (fftData.data());
+
+        for (int channel = 0; channel < numChannels; channel++)
+            grain.write (channel, 0, fftData.data(), grainSamples, channelGains[channel]);
+
+        return;
+    }
+
+    for (int channel = 0; channel < numChannels; channel++)
+    {
+        if (mode == ChannelMode::LinkedStereo && channel + 1 < numChannels)
+        {
+            // two channels from one complex transform, A in the real parts and B in the imaginary parts
+            phases.toCartesianPair (mags.getReadPointer (channel), mags.getReadPointer (channel + 1), fftData.data());
+            pairFft.performComplexTransform (fftData.data(), true);
+
+            const float scale = 1.0f / static_cast<float> (grainSamples);
+            grain.write (channel, 0, fftData.data(), grainSamples, scale, 2);
+            grain.write (channel + 1, 0, fftData.data() + 1, grainSamples, scale, 2);
+
+            channel++;
+            continue;
+        }
+
+        phases.toCartesian (mags.getReadPointer (channel), fftData.data());
+        fft.performRealOnlyInverseTransform (fftData.data());
+
+        grain.write (channel, 0, fftData.data(), grainSamples);
+    }
+}
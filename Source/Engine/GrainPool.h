@@ -0,0 +1,140 @@
+/*
+  ==============================================================================
+
+    GrainPool.h
+
+    Background resynthesis of freeze grains. A GrainWorker keeps a set of
+    spare grains filled from the most recently published freeze spectrum, and
+    the audio thread swaps a spent grain for a fresh one without locking. The
+    worker sleeps until the audio thread hands it a spent grain or a spectrum.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Fft.h"
+#include "GrainBuffer.h"
+#include "GrainWorker.h"
+#include "RandomPhaseSpectrum.h"
+#include "SampleBuffer.h"
+#include "SharedTables.h"
+#include "SpscFifo.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//==============================================================================
+/** How the channels of a freeze spectrum are analysed and resynthesised.
+
+    Independent channels each have their own magnitudes and real transforms.
+    LinkedStereo channels go in pairs, two real channels to one complex
+    transform. MidSide channels share the magnitudes of the mid signal, kept
+    in channel 0, with a gain per channel, so one transform serves them all.
+*/
+enum class ChannelMode
+{
+    Independent,
+    LinkedStereo,
+    MidSide
+};
+
+//==============================================================================
+/**
+*/
+class GrainPool
+{
+public:
+    struct Grain
+    {
+        GrainBuffer buffer;
+        std::uint32_t generation = 0;
+    };
+
+    //==============================================================================
+    GrainPool();
+
+    // while the audio thread and the worker are stopped, grains can then be
+    // any size from 2^minFftOrder to 2^maxFftOrder, with numSpare of them
+    // being rendered while the active ones play
+    void prepare (GrainWorker& workerToWake, int numChannels, int minFftOrder, int maxFftOrder, int numActive, int numSpare,
+                  GrainBuffer::Format format = GrainBuffer::Format::Float32);
+
+    // roughly what prepare allocates, the grains and spectra dominate
+    static std::size_t getMemoryUsage (int numChannels, int maxFftOrder, int numActive, int numSpare,
+                                       GrainBuffer::Format format = GrainBuffer::Format::Float32);
+
+    // audio thread
+    GrainBuffer& getActiveGrain (int index) { return activeGrains[static_cast<size_t> (index)]->buffer; }
+    std::uint32_t getGeneration() const { return audioGeneration; }
+    void publishSpectrum (const SampleBuffer& mags, int fftOrder,
+                          ChannelMode mode = ChannelMode::Independent, const float* channelGains = nullptr);
+    bool renewActiveGrain (int index, bool waitForWorker);
+
+    // any thread
+    void setSeed (std::uint64_t newSeed) { seed = newSeed; }
+    std::uint64_t getSeed() const { return seed.load(); }
+    int getNumUnderruns() const { return numUnderruns.load(); }
+    int getNumRenewals() const { return numRenewals.load(); }
+
+    // worker thread, renders a spent grain from the latest spectrum if
+    // there is one, and returns whether there was
+    bool synthesiseFreeGrain (std::vector<float>& fftData, RandomPhaseSpectrum& phases);
+
+    //==============================================================================
+    // fft sets the grain size, pairFft is twice that, and fftData holds 2 grains
+    // of floats. grain may be longer, but only the first fft.getSize() samples are written.
+    static void synthesise (const SampleBuffer& mags, ChannelMode mode, const float* channelGains, GrainBuffer& grain,
+                            const Fft& fft, const Fft& pairFft, std::vector<float>& fftData, const RandomPhaseSpectrum& phases);
+
+private:
+    //==============================================================================
+    bool pullLatestSpectrum();
+    Grain* popReadyGrain();
+
+    static constexpr int maxWorkerWaitMs = 2000;
+    static constexpr int spectrumDirtyFlag = 4;
+    static constexpr int spectrumIndexMask = 3;
+
+    // grain storage, active grains are owned by the audio thread
+    std::vector<std::unique_ptr<Grain>> grainStorage;
+    std::vector<Grain*> activeGrains;
+    int numActiveGrains = 0;
+
+    // free grains (audio -> worker) and ready grains (worker -> audio)
+    SpscFifo<Grain*> freeGrains;
+    SpscFifo<Grain*> readyGrains;
+
+    // spectrum triple buffer, the audio thread writes the back slot and the
+    // worker reads the front slot
+    std::array<SampleBuffer, 3> spectra;
+    std::array<std::uint32_t, 3> spectrumGenerations {};
+    std::array<int, 3> spectrumOrders {};
+    std::array<ChannelMode, 3> spectrumModes {};
+    std::array<std::vector<float>, 3> spectrumGains;
+    std::atomic<int> spectrumExchange { 1 };
+    int spectrumBackIndex = 0;
+    int spectrumFrontIndex = 2;
+    std::uint32_t audioGeneration = 0;
+
+    // worker
+    GrainWorker* worker = nullptr;
+    int minOrder = 0;
+    std::vector<std::shared_ptr<const Fft>> workerFfts;
+    std::vector<std::shared_ptr<const Fft>> workerPairFfts;
+    std::uint64_t workerSerial = 0;
+
+    // grains are seeded from (seed, spectrum generation, serial), so a render
+    // with a fixed seed is reproducible as long as no grain underruns
+    std::atomic<std::uint64_t> seed;
+    std::atomic<int> numUnderruns { 0 };
+    std::atomic<int> numRenewals { 0 };
+
+    //==============================================================================
+    GrainPool (const GrainPool&) = delete;
+    GrainPool& operator= (const GrainPool&) = delete;
+};
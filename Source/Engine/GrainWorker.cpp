@@ -0,0 +1,58 @@
+/*
+  ==============================================================================
+
+    GrainWorker.cpp
+
+  ==============================================================================
+*/
+
+#include "GrainWorker.h"
+
+#include "GrainPool.h"
+
+//==============================================================================
+GrainWorker::~GrainWorker()
+{
+    stop();
+}
+
+void GrainWorker::start (const std::vector<GrainPool*>& poolsToServe, int maxFftOrder)
+{
+    stop();
+
+    // the scratch is big enough for the largest grain of any pool
+    const int grainSamples = 1 << maxFftOrder;
+    pools = poolsToServe;
+    fftData.resize (static_cast<size_t> (2 * grainSamples));
+    phases.prepare (grainSamples / 2);
+
+    shouldExit = false;
+    thread = std::thread ([this] { run(); });
+}
+
+void GrainWorker::stop()
+{
+    if (thread.joinable())
+    {
+        shouldExit = true;
+        wakeup.signal();
+        thread.join();
+    }
+}
+
+//==============================================================================
+void GrainWorker::run()
+{
+    while (! shouldExit)
+    {
+        bool didWork = false;
+
+        for (auto* pool : pools)
+            didWork = pool->synthesiseFreeGrain (fftData, phases) || didWork;
+
+        // every grain pushed and spectrum published signals once, so
+        // nothing that arrives during a pass is missed
+        if (! didWork)
+            wakeup.wait();
+    }
+}
@@ -0,0 +1,57 @@
+/*
+  ==============================================================================
+
+    GrainWorker.h
+
+    The background thread that keeps the spare grains of a set of GrainPools
+    filled. One worker serves every layer of an engine, a grain from each
+    pool in turn, with one set of transform scratch between them. It sleeps
+    until a pool hands it a spent grain or a spectrum.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "RandomPhaseSpectrum.h"
+#include "Semaphore.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+class GrainPool;
+
+//==============================================================================
+/**
+*/
+class GrainWorker
+{
+public:
+    //==============================================================================
+    GrainWorker() = default;
+    ~GrainWorker();
+
+    // while the audio thread is stopped, the pools must stay prepared until
+    // the worker is stopped again
+    void start (const std::vector<GrainPool*>& poolsToServe, int maxFftOrder);
+    void stop();
+
+    // any thread, never blocks
+    void wake() { wakeup.signal(); }
+
+private:
+    //==============================================================================
+    void run();
+
+    std::thread thread;
+    Semaphore wakeup;
+    std::atomic<bool> shouldExit { false };
+    std::vector<GrainPool*> pools;
+    std::vector<float> fftData;
+    RandomPhaseSpectrum phases;
+
+    //==============================================================================
+    GrainWorker (const GrainWorker&) = delete;
+    GrainWorker& operator= (const GrainWorker&) = delete;
+};
@@ -0,0 +1,132 @@
+/*
+  ==============================================================================
+
+    LevelDetector.cpp
+
+  ==============================================================================
+*/
+
+#include "LevelDetector.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define AUTOFREEZE_LEVEL_SSE2 1
+#elif defined (__ARM_NEON) || defined (__ARM_NEON__) || defined (_M_ARM64)
+ #include <arm_neon.h>
+ #define AUTOFREEZE_LEVEL_NEON 1
+#endif
+
+//==============================================================================
+namespace
+{
+    // the largest absolute value and the sum of squares, four lanes at a time
+    void measure (const float* data, int numSamples, float& peak, float& sumOfSquares)
+    {
+        int i = 0;
+        peak = 0.0f;
+        sumOfSquares = 0.0f;
+
+       #if AUTOFREEZE_LEVEL_SSE2
+        const __m128 absMask = _mm_castsi128_ps (_mm_set1_epi32 (0x7fffffff));
+        __m128 peaks = _mm_setzero_ps();
+        __m128 sums = _mm_setzero_ps();
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const __m128 x = _mm_loadu_ps (data + i);
+            peaks = _mm_max_ps (peaks, _mm_and_ps (x, absMask));
+            sums = _mm_add_ps (sums, _mm_mul_ps (x, x));
+        }
+
+        alignas (16) float lanes[4];
+        _mm_store_ps (lanes, peaks);
+        peak = std::max (std::max (lanes[0], lanes[1]), std::max (lanes[2], lanes[3]));
+        _mm_store_ps (lanes, sums);
+        sumOfSquares = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+       #elif AUTOFREEZE_LEVEL_NEON
+        float32x4_t peaks = vdupq_n_f32 (0.0f);
+        float32x4_t sums = vdupq_n_f32 (0.0f);
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const float32x4_t x = vld1q_f32 (data + i);
+            peaks = vmaxq_f32 (peaks, vabsq_f32 (x));
+            sums = vmlaq_f32 (sums, x, x);
+        }
+
+        float lanes[4];
+        vst1q_f32 (lanes, peaks);
+        peak = std::max (std::max (lanes[0], lanes[1]), std::max (lanes[2], lanes[3]));
+        vst1q_f32 (lanes, sums);
+        sumOfSquares = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+       #endif
+
+        for (; i < numSamples; i++)
+        {
+            peak = std::max (peak, std::abs (data[i]));
+            sumOfSquares += data[i] * data[i];
+        }
+    }
+}
+
+//==============================================================================
+void LevelDetector::prepare (double newSampleRate, int numChannels, float newAttackSeconds, float newReleaseSeconds)
+{
+    sampleRate = newSampleRate;
+    attackSeconds = newAttackSeconds;
+    releaseSeconds = newReleaseSeconds;
+
+    levels.resize (static_cast<size_t> (numChannels));
+    meanSquareEnvelopes.resize (static_cast<size_t> (numChannels));
+    reset();
+}
+
+void LevelDetector::reset()
+{
+    std::fill (levels.begin(), levels.end(), Levels {});
+    std::fill (meanSquareEnvelopes.begin(), meanSquareEnvelopes.end(), 0.0f);
+    averageLevels = {};
+}
+
+void LevelDetector::process (const SampleBlock& block)
+{
+    const int numChannels = std::min (block.getNumChannels(), static_cast<int> (levels.size()));
+    const int numSamples = block.getNumSamples();
+
+    if (numChannels == 0 || numSamples == 0)
+        return;
+
+    // the envelope follows the mean square a block at a time, so the time
+    // constants hold whatever the block size
+    const double blockSeconds = numSamples / sampleRate;
+    const auto attack = static_cast<float> (attackSeconds > 0.0f ? std::exp (-blockSeconds / attackSeconds) : 0.0);
+    const auto release = static_cast<float> (releaseSeconds > 0.0f ? std::exp (-blockSeconds / releaseSeconds) : 0.0);
+
+    averageLevels = {};
+
+    for (int channel = 0; channel < numChannels; channel++)
+    {
+        auto& channelLevels = levels[static_cast<size_t> (channel)];
+        auto& envelope = meanSquareEnvelopes[static_cast<size_t> (channel)];
+
+        float sumOfSquares;
+        measure (block.getReadPointer (channel), numSamples, channelLevels.peak, sumOfSquares);
+
+        const float meanSquare = sumOfSquares / static_cast<float> (numSamples);
+        envelope = meanSquare + (meanSquare > envelope ? attack : release) * (envelope - meanSquare);
+
+        channelLevels.rms = std::sqrt (meanSquare);
+        channelLevels.envelope = std::sqrt (envelope);
+
+        averageLevels.peak += channelLevels.peak;
+        averageLevels.rms += channelLevels.rms;
+        averageLevels.envelope += channelLevels.envelope;
+    }
+
+    averageLevels.peak /= static_cast<float> (numChannels);
+    averageLevels.rms /= static_cast<float> (numChannels);
+    averageLevels.envelope /= static_cast<float> (numChannels);
+}
@@ -0,0 +1,52 @@
+/*
+  ==============================================================================
+
+    LevelDetector.h
+
+    Peak, RMS and a smoothed attack/release envelope for every channel of a
+    block, all measured in one pass over the samples.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "SampleBuffer.h"
+
+#include <vector>
+
+//==============================================================================
+/**
+*/
+class LevelDetector
+{
+public:
+    struct Levels
+    {
+        float peak = 0.0f;
+        float rms = 0.0f;
+        float envelope = 0.0f;  // an RMS level, smoothed across blocks
+    };
+
+    //==============================================================================
+    // allocates, so call this while audio isn't running
+    void prepare (double sampleRate, int numChannels, float attackSeconds, float releaseSeconds);
+    void reset();
+
+    // real-time safe, measures every channel of the block
+    void process (const SampleBlock& block);
+
+    const Levels& getLevels (int channel) const { return levels[static_cast<size_t> (channel)]; }
+
+    // averaged over the channels of the last block
+    const Levels& getAverageLevels() const { return averageLevels; }
+
+private:
+    double sampleRate = 44100.0;
+    float attackSeconds = 0.0f;
+    float releaseSeconds = 0.0f;
+
+    std::vector<Levels> levels;
+    std::vector<float> meanSquareEnvelopes;
+    Levels averageLevels;
+};
@@ -0,0 +1,260 @@
+/*
+  ==============================================================================
+
+    RandomPhaseSpectrum.cpp
+
+  ==============================================================================
+*/
+
+#include "RandomPhaseSpectrum.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define AUTOFREEZE_PHASE_SSE2 1
+#elif defined (__ARM_NEON) || defined (__ARM_NEON__) || defined (_M_ARM64)
+ #include <arm_neon.h>
+ #define AUTOFREEZE_PHASE_NEON 1
+#endif
+
+//==============================================================================
+// The phase of each bin is built from one 32 bit draw: the low two bits pick a
+// quadrant and the top 23 bits an offset of -pi/4..pi/4 within it, so the
+// polynomials only ever see small angles and no range reduction is needed.
+namespace
+{
+    constexpr float halfPi = 1.5707963267948966f;
+    constexpr float quarterPi = 0.7853981633974483f;
+
+    // Taylor coefficients, accurate to better than 1e-6 on [-pi/4, pi/4]
+    constexpr float sin3 = -1.0f / 6.0f;
+    constexpr float sin5 = 1.0f / 120.0f;
+    constexpr float sin7 = -1.0f / 5040.0f;
+    constexpr float cos2 = -1.0f / 2.0f;
+    constexpr float cos4 = 1.0f / 24.0f;
+    constexpr float cos6 = -1.0f / 720.0f;
+    constexpr float cos8 = 1.0f / 40320.0f;
+
+    constexpr std::uint32_t floatOneBits = 0x3f800000u;
+
+    std::uint64_t splitMix64 (std::uint64_t x)
+    {
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+   #if ! (AUTOFREEZE_PHASE_SSE2 || AUTOFREEZE_PHASE_NEON)
+    float bitsToFloat (std::uint32_t bits)
+    {
+        float value;
+        std::memcpy (&value, &bits, sizeof (float));
+        return value;
+    }
+
+    std::uint32_t floatToBits (float value)
+    {
+        std::uint32_t bits;
+        std::memcpy (&bits, &value, sizeof (float));
+        return bits;
+    }
+   #endif
+}
+
+//==============================================================================
+void RandomPhaseSpectrum::prepare (int newNumBins)
+{
+    numBins = newNumBins;
+    cosines.assign (numBins, 1.0f);
+    sines.assign (numBins, 0.0f);
+}
+
+void RandomPhaseSpectrum::setNumBins (int newNumBins)
+{
+    numBins = std::min (newNumBins, static_cast<int> (cosines.size()));
+}
+
+void RandomPhaseSpectrum::randomise (std::uint64_t seed, std::uint64_t generation, std::uint64_t serial)
+{
+    alignas (16) std::uint32_t state[numLanes];
+    std::uint64_t mixed = splitMix64 (splitMix64 (splitMix64 (seed) ^ generation) ^ serial);
+
+    for (int lane = 0; lane < numLanes; lane++)
+    {
+        mixed = splitMix64 (mixed);
+        state[lane] = static_cast<std::uint32_t> (mixed >> 32) | 1u; // xorshift state must never be zero
+    }
+
+    float* cosData = cosines.data();
+    float* sinData = sines.data();
+
+   #if AUTOFREEZE_PHASE_SSE2
+    __m128i x = _mm_load_si128 (reinterpret_cast<const __m128i*> (state));
+    const __m128i one = _mm_set1_epi32 (1);
+    const __m128i oneBits = _mm_set1_epi32 (static_cast<int> (floatOneBits));
+    const __m128 oneFloat = _mm_set1_ps (1.0f);
+
+    for (int bin = 0; bin < numBins; bin += numLanes)
+    {
+        x = _mm_xor_si128 (x, _mm_slli_epi32 (x, 13));
+        x = _mm_xor_si128 (x, _mm_srli_epi32 (x, 17));
+        x = _mm_xor_si128 (x, _mm_slli_epi32 (x, 5));
+
+        const __m128 unit = _mm_sub_ps (_mm_castsi128_ps (_mm_or_si128 (_mm_srli_epi32 (x, 9), oneBits)), oneFloat);
+        const __m128 a = _mm_sub_ps (_mm_mul_ps (unit, _mm_set1_ps (halfPi)), _mm_set1_ps (quarterPi));
+        const __m128 a2 = _mm_mul_ps (a, a);
+
+        __m128 sinA = _mm_add_ps (_mm_set1_ps (sin5), _mm_mul_ps (a2, _mm_set1_ps (sin7)));
+        sinA = _mm_add_ps (_mm_set1_ps (sin3), _mm_mul_ps (a2, sinA));
+        sinA = _mm_mul_ps (a, _mm_add_ps (oneFloat, _mm_mul_ps (a2, sinA)));
+
+        __m128 cosA = _mm_add_ps (_mm_set1_ps (cos6), _mm_mul_ps (a2, _mm_set1_ps (cos8)));
+        cosA = _mm_add_ps (_mm_set1_ps (cos4), _mm_mul_ps (a2, cosA));
+        cosA = _mm_add_ps (_mm_set1_ps (cos2), _mm_mul_ps (a2, cosA));
+        cosA = _mm_add_ps (oneFloat, _mm_mul_ps (a2, cosA));
+
+        // odd quadrants swap sin and cos, then the quadrant sets the signs
+        const __m128 odd = _mm_castsi128_ps (_mm_cmpeq_epi32 (_mm_and_si128 (x, one), one));
+        __m128 c = _mm_or_ps (_mm_and_ps (odd, sinA), _mm_andnot_ps (odd, cosA));
+        __m128 s = _mm_or_ps (_mm_and_ps (odd, cosA), _mm_andnot_ps (odd, sinA));
+
+        const __m128i cosSign = _mm_slli_epi32 (_mm_and_si128 (_mm_xor_si128 (x, _mm_srli_epi32 (x, 1)), one), 31);
+        const __m128i sinSign = _mm_slli_epi32 (_mm_and_si128 (_mm_srli_epi32 (x, 1), one), 31);
+        c = _mm_xor_ps (c, _mm_castsi128_ps (cosSign));
+        s = _mm_xor_ps (s, _mm_castsi128_ps (sinSign));
+
+        _mm_storeu_ps (cosData + bin, c);
+        _mm_storeu_ps (sinData + bin, s);
+    }
+   #elif AUTOFREEZE_PHASE_NEON
+    uint32x4_t x = vld1q_u32 (state);
+    const uint32x4_t one = vdupq_n_u32 (1);
+    const uint32x4_t oneBits = vdupq_n_u32 (floatOneBits);
+    const float32x4_t oneFloat = vdupq_n_f32 (1.0f);
+
+    for (int bin = 0; bin < numBins; bin += numLanes)
+    {
+        x = veorq_u32 (x, vshlq_n_u32 (x, 13));
+        x = veorq_u32 (x, vshrq_n_u32 (x, 17));
+        x = veorq_u32 (x, vshlq_n_u32 (x, 5));
+
+        const float32x4_t unit = vsubq_f32 (vreinterpretq_f32_u32 (vorrq_u32 (vshrq_n_u32 (x, 9), oneBits)), oneFloat);
+        const float32x4_t a = vsubq_f32 (vmulq_n_f32 (unit, halfPi), vdupq_n_f32 (quarterPi));
+        const float32x4_t a2 = vmulq_f32 (a, a);
+
+        float32x4_t sinA = vaddq_f32 (vdupq_n_f32 (sin5), vmulq_n_f32 (a2, sin7));
+        sinA = vaddq_f32 (vdupq_n_f32 (sin3), vmulq_f32 (a2, sinA));
+        sinA = vmulq_f32 (a, vaddq_f32 (oneFloat, vmulq_f32 (a2, sinA)));
+
+        float32x4_t cosA = vaddq_f32 (vdupq_n_f32 (cos6), vmulq_n_f32 (a2, cos8));
+        cosA = vaddq_f32 (vdupq_n_f32 (cos4), vmulq_f32 (a2, cosA));
+        cosA = vaddq_f32 (vdupq_n_f32 (cos2), vmulq_f32 (a2, cosA));
+        cosA = vaddq_f32 (oneFloat, vmulq_f32 (a2, cosA));
+
+        // odd quadrants swap sin and cos, then the quadrant sets the signs
+        const uint32x4_t odd = vceqq_u32 (vandq_u32 (x, one), one);
+        const float32x4_t c = vbslq_f32 (odd, sinA, cosA);
+        const float32x4_t s = vbslq_f32 (odd, cosA, sinA);
+
+        const uint32x4_t cosSign = vshlq_n_u32 (vandq_u32 (veorq_u32 (x, vshrq_n_u32 (x, 1)), one), 31);
+        const uint32x4_t sinSign = vshlq_n_u32 (vandq_u32 (vshrq_n_u32 (x, 1), one), 31);
+
+        vst1q_f32 (cosData + bin, vreinterpretq_f32_u32 (veorq_u32 (vreinterpretq_u32_f32 (c), cosSign)));
+        vst1q_f32 (sinData + bin, vreinterpretq_f32_u32 (veorq_u32 (vreinterpretq_u32_f32 (s), sinSign)));
+    }
+   #else
+    for (int bin = 0; bin < numBins; bin += numLanes)
+    {
+        for (int lane = 0; lane < numLanes; lane++)
+        {
+            std::uint32_t x = state[lane];
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            state[lane] = x;
+
+            const float unit = bitsToFloat ((x >> 9) | floatOneBits) - 1.0f;
+            const float a = unit * halfPi - quarterPi;
+            const float a2 = a * a;
+            const float sinA = a * (1.0f + a2 * (sin3 + a2 * (sin5 + a2 * sin7)));
+            const float cosA = 1.0f + a2 * (cos2 + a2 * (cos4 + a2 * (cos6 + a2 * cos8)));
+
+            // odd quadrants swap sin and cos, then the quadrant sets the signs
+            const bool odd = (x & 1u) != 0;
+            const std::uint32_t cosSign = ((x ^ (x >> 1)) & 1u) << 31;
+            const std::uint32_t sinSign = ((x >> 1) & 1u) << 31;
+
+            cosData[bin + lane] = bitsToFloat (floatToBits (odd ? sinA : cosA) ^ cosSign);
+            sinData[bin + lane] = bitsToFloat (floatToBits (odd ? cosA : sinA) ^ sinSign);
+        }
+    }
+   #endif
+}
+
+void RandomPhaseSpectrum::toCartesian (const float* mags, float* fftData) const
+{
+    const float* cosData = cosines.data();
+    const float* sinData = sines.data();
+
+   #if AUTOFREEZE_PHASE_SSE2
+    for (int bin = 0; bin < numBins; bin += numLanes)
+    {
+        const __m128 mag = _mm_loadu_ps (mags + bin);
+        const __m128 real = _mm_mul_ps (mag, _mm_loadu_ps (cosData + bin));
+        const __m128 imag = _mm_mul_ps (mag, _mm_loadu_ps (sinData + bin));
+        _mm_storeu_ps (fftData + 2 * bin, _mm_unpacklo_ps (real, imag));
+        _mm_storeu_ps (fftData + 2 * bin + 4, _mm_unpackhi_ps (real, imag));
+    }
+   #elif AUTOFREEZE_PHASE_NEON
+    for (int bin = 0; bin < numBins; bin += numLanes)
+    {
+        const float32x4_t mag = vld1q_f32 (mags + bin);
+        float32x4x2_t complex;
+        complex.val[0] = vmulq_f32 (mag, vld1q_f32 (cosData + bin));
+        complex.val[1] = vmulq_f32 (mag, vld1q_f32 (sinData + bin));
+        vst2q_f32 (fftData + 2 * bin, complex);
+    }
+   #else
+    for (int bin = 0; bin < numBins; bin++)
+    {
+        fftData[2 * bin] = mags[bin] * cosData[bin];
+        fftData[2 * bin + 1] = mags[bin] * sinData[bin];
+    }
+   #endif
+
+    // DC & Nyquist handling
+    fftData[0] = mags[0];
+    fftData[1] = 0.0f;
+    fftData[2 * numBins] = mags[numBins];
+    fftData[2 * numBins + 1] = 0.0f;
+}
+
+void RandomPhaseSpectrum::toCartesianPair (const float* magsA, const float* magsB, float* complexData) const
+{
+    const float* cosData = cosines.data();
+    const float* sinData = sines.data();
+    const int size = 2 * numBins;
+
+    // Z[k] = A[k] + iB[k] and, as both signals are real, Z[N-k] = conj A[k] + i conj B[k]
+    for (int bin = 1; bin < numBins; bin++)
+    {
+        const float ar = magsA[bin] * cosData[bin];
+        const float ai = magsA[bin] * sinData[bin];
+        const float br = magsB[bin] * cosData[bin];
+        const float bi = magsB[bin] * sinData[bin];
+
+        complexData[2 * bin] = ar - bi;
+        complexData[2 * bin + 1] = ai + br;
+        complexData[2 * (size - bin)] = ar + bi;
+        complexData[2 * (size - bin) + 1] = br - ai;
+    }
+
+    // DC & Nyquist handling
+    complexData[0] = magsA[0];
+    complexData[1] = magsB[0];
+    complexData[2 * numBins] = magsA[numBins];
+    complexData[2 * numBins + 1] = magsB[numBins];
+}
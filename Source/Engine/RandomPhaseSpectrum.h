@@ -0,0 +1,54 @@
+/*
+  ==============================================================================
+
+    RandomPhaseSpectrum.h
+
+    Builds the random-phase spectra that freeze grains are resynthesised from.
+    Phases come from a vectorised xorshift generator and a polynomial sin/cos
+    kernel (SSE2 or NEON where available), so no trig library calls are made.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+//==============================================================================
+/**
+*/
+class RandomPhaseSpectrum
+{
+public:
+    static constexpr int numLanes = 4;
+
+    // numBins is half the FFT size and must be a multiple of numLanes
+    void prepare (int numBins);
+
+    // switches to a smaller FFT size without allocating, up to the size prepared for
+    void setNumBins (int newNumBins);
+
+    // Draws a new phase for every bin. The same seed, generation and serial
+    // always produce the same phases.
+    void randomise (std::uint64_t seed, std::uint64_t generation, std::uint64_t serial);
+
+    // Writes mags with the current phases into fftData as interleaved complex
+    // values, in the layout Fft::performRealOnlyInverseTransform
+    // expects. mags must hold numBins + 1 values, fftData 2 * numBins + 2.
+    void toCartesian (const float* mags, float* fftData) const;
+
+    // Packs two real spectra that share the current phases into one full
+    // complex spectrum, A + iB, for an inverse complex transform of
+    // 2 * numBins points. The real part of the result is then the signal for
+    // magsA and the imaginary part the signal for magsB. complexData must
+    // hold 4 * numBins values.
+    void toCartesianPair (const float* magsA, const float* magsB, float* complexData) const;
+
+    int getNumBins() const { return numBins; }
+
+private:
+    int numBins = 0;
+    std::vector<float> cosines;
+    std::vector<float> sines;
+};
@@ -0,0 +1,134 @@
+/*
+  ==============================================================================
+
+    SampleBuffer.h
+
+    Minimal multichannel sample storage for the engine, so that it doesn't
+    depend on juce::AudioBuffer. SampleBuffer owns contiguous storage and
+    SampleBlock is a non-owning view of a range of samples in some channels.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+//==============================================================================
+/**
+*/
+class SampleBlock
+{
+public:
+    static constexpr int maxChannels = 64;
+
+    SampleBlock() = default;
+
+    SampleBlock (float* const* data, int numChannelsToUse, int startSample, int numSamplesToUse)
+        : numChannels (numChannelsToUse), numSamples (numSamplesToUse)
+    {
+        assert (numChannels <= maxChannels);
+
+        for (int channel = 0; channel < numChannels; channel++)
+            channels[channel] = data[channel] + startSample;
+    }
+
+    int getNumChannels() const { return numChannels; }
+    int getNumSamples() const { return numSamples; }
+
+    const float* getReadPointer (int channel) const { return channels[channel]; }
+    float* getWritePointer (int channel) const { return channels[channel]; }
+    float* const* getArrayOfWritePointers() const { return channels.data(); }
+
+    SampleBlock getSubBlock (int startSample, int numSamplesToUse) const
+    {
+        return { channels.data(), numChannels, startSample, numSamplesToUse };
+    }
+
+    void clear (int channel, int startSample, int numSamplesToClear) const
+    {
+        std::fill (channels[channel] + startSample, channels[channel] + startSample + numSamplesToClear, 0.0f);
+    }
+
+    void clear() const
+    {
+        for (int channel = 0; channel < numChannels; channel++)
+            clear (channel, 0, numSamples);
+    }
+
+    float getRMSLevel (int channel, int startSample, int numSamplesToRead) const
+    {
+        if (numSamplesToRead <= 0)
+            return 0.0f;
+
+        const float* data = channels[channel] + startSample;
+        double sum = 0.0;
+
+        for (int i = 0; i < numSamplesToRead; i++)
+            sum += data[i] * data[i];
+
+        return static_cast<float> (std::sqrt (sum / numSamplesToRead));
+    }
+
+private:
+    std::array<float*, maxChannels> channels {};
+    int numChannels = 0;
+    int numSamples = 0;
+};
+
+//==============================================================================
+/**
+*/
+class SampleBuffer
+{
+public:
+    SampleBuffer() = default;
+    SampleBuffer (int numChannelsToAllocate, int numSamplesToAllocate)   { setSize (numChannelsToAllocate, numSamplesToAllocate); }
+
+    SampleBuffer (const SampleBuffer&) = delete;
+    SampleBuffer& operator= (const SampleBuffer&) = delete;
+
+    // allocates, so never call this from the audio thread
+    void setSize (int newNumChannels, int newNumSamples)
+    {
+        numChannels = newNumChannels;
+        numSamples = newNumSamples;
+        data.assign (static_cast<size_t> (numChannels) * static_cast<size_t> (numSamples), 0.0f);
+        channels.resize (static_cast<size_t> (numChannels));
+
+        for (int channel = 0; channel < numChannels; channel++)
+            channels[static_cast<size_t> (channel)] = data.data() + static_cast<size_t> (channel) * static_cast<size_t> (numSamples);
+    }
+
+    int getNumChannels() const { return numChannels; }
+    int getNumSamples() const { return numSamples; }
+
+    const float* getReadPointer (int channel) const { return channels[static_cast<size_t> (channel)]; }
+    float* getWritePointer (int channel) { return channels[static_cast<size_t> (channel)]; }
+    float* const* getArrayOfWritePointers() { return channels.data(); }
+
+    SampleBlock getBlock (int startSample, int numSamplesToUse)
+    {
+        return { channels.data(), numChannels, startSample, numSamplesToUse };
+    }
+
+    SampleBlock getBlock()   { return getBlock (0, numSamples); }
+
+    void clear()   { std::fill (data.begin(), data.end(), 0.0f); }
+
+    void copyFrom (int destChannel, int destStartSample, const float* source, int numSamplesToCopy)
+    {
+        std::memcpy (getWritePointer (destChannel) + destStartSample, source, static_cast<size_t> (numSamplesToCopy) * sizeof (float));
+    }
+
+private:
+    std::vector<float> data;
+    std::vector<float*> channels;
+    int numChannels = 0;
+    int numSamples = 0;
+};
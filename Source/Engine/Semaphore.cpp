@@ -0,0 +1,70 @@
+/*
+  ==============================================================================
+
+    Semaphore.cpp
+
+  ==============================================================================
+*/
+
+#include "Semaphore.h"
+
+#if defined (_WIN32)
+ #define WIN32_LEAN_AND_MEAN
+ #include <windows.h>
+#else
+ #include <cerrno>
+#endif
+
+//==============================================================================
+#if defined (__APPLE__)
+
+Semaphore::Semaphore()      : semaphore (dispatch_semaphore_create (0)) {}
+Semaphore::~Semaphore()     { dispatch_release (semaphore); }
+
+void Semaphore::signal (int count)
+{
+    for (int i = 0; i < count; i++)
+        dispatch_semaphore_signal (semaphore);
+}
+
+void Semaphore::wait()
+{
+    dispatch_semaphore_wait (semaphore, DISPATCH_TIME_FOREVER);
+}
+
+//==============================================================================
+#elif defined (_WIN32)
+
+Semaphore::Semaphore()      : semaphore (CreateSemaphoreW (nullptr, 0, 0x7fffffff, nullptr)) {}
+Semaphore::~Semaphore()     { CloseHandle (semaphore); }
+
+void Semaphore::signal (int count)
+{
+    if (count > 0)
+        ReleaseSemaphore (semaphore, count, nullptr);
+}
+
+void Semaphore::wait()
+{
+    WaitForSingleObject (semaphore, INFINITE);
+}
+
+//==============================================================================
+#else
+
+// sem_post only enters the kernel when a thread is waiting, and then only to wake it
+Semaphore::Semaphore()      { sem_init (&semaphore, 0, 0); }
+Semaphore::~Semaphore()     { sem_destroy (&semaphore); }
+
+void Semaphore::signal (int count)
+{
+    for (int i = 0; i < count; i++)
+        sem_post (&semaphore);
+}
+
+void Semaphore::wait()
+{
+    while (sem_wait (&semaphore) != 0 && errno == EINTR) {}
+}
+
+#endif
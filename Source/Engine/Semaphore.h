@@ -0,0 +1,49 @@
+/*
+  ==============================================================================
+
+    Semaphore.h
+
+    A counting semaphore that wakes the engine's background threads. Signalling
+    never blocks, locks or allocates, so the audio thread can hand over work
+    and carry on, and the thread it wakes sleeps until there's something to
+    do rather than polling for it.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#if defined (__APPLE__)
+ #include <dispatch/dispatch.h>
+#elif ! defined (_WIN32)
+ #include <semaphore.h>
+#endif
+
+//==============================================================================
+/**
+*/
+class Semaphore
+{
+public:
+    Semaphore();
+    ~Semaphore();
+
+    // any thread, the audio thread included
+    void signal (int count = 1);
+
+    // background threads only, takes one signal, waiting for it if need be
+    void wait();
+
+private:
+   #if defined (__APPLE__)
+    dispatch_semaphore_t semaphore;
+   #elif defined (_WIN32)
+    void* semaphore;
+   #else
+    sem_t semaphore;
+   #endif
+
+    //==============================================================================
+    Semaphore (const Semaphore&) = delete;
+    Semaphore& operator= (const Semaphore&) = delete;
+};
@@ -0,0 +1,145 @@
+/*
+  ==============================================================================
+
+    SharedTables.cpp
+
+  ==============================================================================
+*/
+
+#include "SharedTables.h"
+
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <utility>
+
+//==============================================================================
+namespace
+{
+    constexpr double pi = 3.141592653589793;
+
+    // Tables are only held weakly, so each one is freed with the last engine
+    // that uses it, and built again by the next one to ask.
+    template <typename Key, typename Table>
+    class TableCache
+    {
+    public:
+        template <typename Builder>
+        std::shared_ptr<const Table> get (const Key& key, Builder&& build)
+        {
+            const std::lock_guard<std::mutex> lock (mutex);
+            const auto found = tables.find (key);
+
+            if (found != tables.end())
+            {
+                if (auto table = found->second.lock())
+                    return table;
+            }
+
+            // only a miss adds an entry, so that's when the freed ones go
+            removeExpired();
+
+            std::shared_ptr<const Table> table = build();
+            tables[key] = table;
+            return table;
+        }
+
+        int getNumAlive()
+        {
+            const std::lock_guard<std::mutex> lock (mutex);
+            removeExpired();
+            return static_cast<int> (tables.size());
+        }
+
+    private:
+        // with the mutex held
+        void removeExpired()
+        {
+            for (auto it = tables.begin(); it != tables.end();)
+            {
+                if (it->second.expired())
+                    it = tables.erase (it);
+                else
+                    ++it;
+            }
+        }
+
+        std::mutex mutex;
+        std::map<Key, std::weak_ptr<const Table>> tables;
+    };
+
+    TableCache<int, Fft> ffts;
+    TableCache<std::pair<int, int>, SharedTables::Window> windows;
+    TableCache<int, SharedTables::FadeCurve> fadeCurves;
+}
+
+//==============================================================================
+std::shared_ptr<const Fft> SharedTables::getFft (int order)
+{
+    return ffts.get (order, [order] { return std::make_shared<const Fft> (order); });
+}
+
+// matches juce::dsp::WindowingFunction<float>::hann with normalisation, and
+// since the windows are always a hop apart, the sum of the overlapping ones
+// only depends on the position within a hop
+std::shared_ptr<const SharedTables::Window> SharedTables::getWindow (int size, int numOverlaps)
+{
+    return windows.get ({ size, numOverlaps }, [size, numOverlaps]
+    {
+        auto table = std::make_shared<Window>();
+        auto& window = table->window;
+        window.resize (static_cast<size_t> (size));
+        double sum = 0.0;
+
+        for (int i = 0; i < size; i++)
+        {
+            window[static_cast<size_t> (i)] = static_cast<float> (0.5 - 0.5 * std::cos (2.0 * pi * i / (size - 1)));
+            sum += window[static_cast<size_t> (i)];
+        }
+
+        const float factor = static_cast<float> (size / sum);
+
+        for (auto& value : window)
+            value *= factor;
+
+        const int hop = size / numOverlaps;
+        table->normalisation.resize (static_cast<size_t> (hop));
+
+        for (int i = 0; i < hop; i++)
+        {
+            float windowSum = 0.0f;
+
+            for (int overlap = 0; overlap < numOverlaps; overlap++)
+                windowSum += window[static_cast<size_t> (i + overlap * hop)];
+
+            table->normalisation[static_cast<size_t> (i)] = windowSum != 0.0f ? 1.0f / windowSum : 1.0f;
+        }
+
+        return table;
+    });
+}
+
+// matches the fades the engine has always used
+std::shared_ptr<const SharedTables::FadeCurve> SharedTables::getFadeCurve (int length)
+{
+    return fadeCurves.get (length, [length]
+    {
+        auto curve = std::make_shared<FadeCurve>();
+        curve->fadeIn.resize (static_cast<size_t> (length));
+        curve->fadeOut.resize (static_cast<size_t> (length));
+
+        for (int i = 0; i < length; i++)
+        {
+            const float x = static_cast<float> (i) / length * (3.141592653589793 / 2);
+            curve->fadeIn[static_cast<size_t> (i)] = std::sin (x);
+            curve->fadeOut[static_cast<size_t> (i)] = std::cos (x);
+        }
+
+        return curve;
+    });
+}
+
+//==============================================================================
+int SharedTables::getNumFfts()          { return ffts.getNumAlive(); }
+int SharedTables::getNumWindows()       { return windows.getNumAlive(); }
+int SharedTables::getNumFadeCurves()    { return fadeCurves.getNumAlive(); }
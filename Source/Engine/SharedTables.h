@@ -0,0 +1,51 @@
+/*
+  ==============================================================================
+
+    SharedTables.h
+
+    Read-only tables that every engine in the process shares: the FFTs, the
+    freeze windows with their overlap normalisation, and the fade curves.
+    The first engine to ask for a table builds it, later ones get the same
+    one, and it's freed along with the last reference. Looking a table up
+    locks, so only do it while preparing or on a background thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Fft.h"
+
+#include <memory>
+#include <vector>
+
+//==============================================================================
+/**
+*/
+class SharedTables
+{
+public:
+    struct Window
+    {
+        std::vector<float> window;          // Hann, scaled to a mean of 1
+        std::vector<float> normalisation;   // a hop long, inverts the sum of the overlapping windows
+    };
+
+    struct FadeCurve
+    {
+        std::vector<float> fadeIn;          // a quarter sine
+        std::vector<float> fadeOut;         // a quarter cosine
+    };
+
+    // The windows of grains numOverlaps to a window, each a hop apart. Fade
+    // curves are keyed by their length in samples, which takes in the
+    // sample rate, since the same curve serves any rate it comes out at.
+    static std::shared_ptr<const Fft> getFft (int order);
+    static std::shared_ptr<const Window> getWindow (int size, int numOverlaps);
+    static std::shared_ptr<const FadeCurve> getFadeCurve (int length);
+
+    // how many tables of each kind are alive, for checking that they're shared
+    static int getNumFfts();
+    static int getNumWindows();
+    static int getNumFadeCurves();
+};
@@ -0,0 +1,200 @@
+/*
+  ==============================================================================
+
+    SpectralStream.cpp
+
+  ==============================================================================
+*/
+
+#include "SpectralStream.h"
+
+#include <algorithm>
+#include <cmath>
+
+//==============================================================================
+void SpectralStream::prepare (int newNumChannels, const Fft& newFft, const float* newWindow, const float* newNormalisation)
+{
+    fft = &newFft;
+    window = newWindow;
+    normalisation = newNormalisation;
+    frameSize = fft->getSize();
+    hop = frameSize / numOverlaps;
+    numBins = frameSize / 2 + 1;
+    numChannels = newNumChannels;
+
+    envelope.setSize (numChannels, numBins);
+    gains.assign (static_cast<size_t> (numChannels), 1.0f);
+    frameData.setSize (numChannels, 2 * frameSize);
+    ring.setSize (numChannels, frameSize + hop);
+    phases.prepare (frameSize / 2);
+
+    mode = ChannelMode::Independent;
+    generation = 0;
+    reset();
+}
+
+void SpectralStream::reset()
+{
+    ring.clear();
+    readIndex = 0;
+    frameSerial = 0;
+
+    // the first hop is silent while the first frame is worked on
+    startFrame();
+    hopPosition = 0;
+}
+
+// A bin of the frame covers ratio bins of the freeze, centred on it. Summing
+// their power and scaling it by the frame size keeps the level the same.
+void SpectralStream::setSpectrum (const SampleBuffer& mags, int fftOrder, ChannelMode newMode, const float* channelGains)
+{
+    const int ratio = std::max (1, (1 << fftOrder) / frameSize);
+    const int freezeBins = (1 << fftOrder) / 2 + 1;
+
+    mode = newMode;
+    generation++;
+
+    for (int channel = 0; channel < getNumSlots(); channel++)
+    {
+        const float* source = mags.getReadPointer (channel);
+        float* dest = envelope.getWritePointer (channel);
+
+        for (int bin = 0; bin < numBins; bin++)
+        {
+            const int begin = std::max (0, bin * ratio - ratio / 2);
+            const int end = std::min (freezeBins, bin * ratio + (ratio + 1) / 2);
+            float power = 0.0f;
+
+            for (int freezeBin = begin; freezeBin < end; freezeBin++)
+                power += source[freezeBin] * source[freezeBin];
+
+            dest[bin] = std::sqrt (power) / static_cast<float> (ratio);
+        }
+    }
+
+    for (int channel = 0; channel < numChannels; channel++)
+        gains[static_cast<size_t> (channel)] = channelGains != nullptr ? channelGains[channel] : 1.0f;
+}
+
+//==============================================================================
+void SpectralStream::process (const SampleBlock& buffer, int numChannelsToWrite, int numSamples, bool accumulate)
+{
+    const int ringSamples = ring.getNumSamples();
+
+    // a hop at a time, since a new frame is started on every hop
+    for (int sample = 0; sample < numSamples;)
+    {
+        if (hopPosition == hop)
+        {
+            startFrame();
+            hopPosition = 0;
+        }
+
+        const int spanSamples = std::min ({ numSamples - sample, hop - hopPosition, ringSamples - readIndex });
+        advance (spanSamples);
+
+        for (int channel = 0; channel < numChannelsToWrite; channel++)
+        {
+            float* source = ring.getWritePointer (channel) + readIndex;
+            float* dest = buffer.getWritePointer (channel) + sample;
+            const float* scale = normalisation + hopPosition;
+
+            for (int i = 0; i < spanSamples; i++)
+                dest[i] = accumulate ? dest[i] + source[i] * scale[i] : source[i] * scale[i];
+
+            std::fill (source, source + spanSamples, 0.0f);
+        }
+
+        readIndex = (readIndex + spanSamples) % ringSamples;
+        hopPosition += spanSamples;
+        sample += spanSamples;
+    }
+}
+
+// The frame starts a hop after the one playing now, and is always finished
+// by the time it's heard, since a hop's credit covers every unit.
+void SpectralStream::startFrame()
+{
+    frameStartIndex = (readIndex + hop) % ring.getNumSamples();
+    frameSerial++;
+    taskIndex = 0;
+    taskUnit = 0;
+    credit = 0;
+
+    const std::int64_t frameUnits = static_cast<std::int64_t> (getNumTasks()) * fft->getPassLength();
+    unitsPerSample = (frameUnits + hop - 1) / hop;
+}
+
+void SpectralStream::advance (int numSamples)
+{
+    const int numUnits = fft->getPassLength();
+    const int numTasks = getNumTasks();
+    const int tasksPerSlot = fft->getNumInversePasses() + 2;
+    credit += numSamples * unitsPerSample;
+
+    while (taskIndex < numTasks && credit > 0)
+    {
+        // drawing phases and building a spectrum can't be split
+        const int slotTask = (taskIndex - 1) % tasksPerSlot;
+        const bool splittable = taskIndex > 0 && slotTask > 0;
+        const int endUnit = splittable ? static_cast<int> (std::min<std::int64_t> (numUnits, taskUnit + credit)) : numUnits;
+
+        runTask (taskIndex, taskUnit, endUnit);
+        credit -= endUnit - taskUnit;
+        taskUnit = endUnit;
+
+        if (taskUnit == numUnits)
+        {
+            taskUnit = 0;
+            taskIndex++;
+        }
+    }
+}
+
+void SpectralStream::runTask (int task, int beginUnit, int endUnit)
+{
+    if (task == 0)
+    {
+        // every channel shares the frame's phases, so the image holds together
+        phases.randomise (seed, generation, frameSerial);
+        return;
+    }
+
+    const int tasksPerSlot = fft->getNumInversePasses() + 2;
+    const int slot = (task - 1) / tasksPerSlot;
+    const int slotTask = (task - 1) % tasksPerSlot;
+    float* data = frameData.getWritePointer (slot);
+
+    if (slotTask == 0)
+    {
+        phases.toCartesian (envelope.getReadPointer (slot), data);
+        return;
+    }
+
+    if (slotTask <= fft->getNumInversePasses())
+    {
+        fft->performInversePass (data, slotTask - 1, beginUnit, endUnit);
+        return;
+    }
+
+    // windowed into the ring, to every channel at its own level in mid/side
+    const int numUnits = fft->getPassLength();
+    const int ringSamples = ring.getNumSamples();
+    const int begin = static_cast<int> (static_cast<std::int64_t> (beginUnit) * frameSize / numUnits);
+    const int end = static_cast<int> (static_cast<std::int64_t> (endUnit) * frameSize / numUnits);
+    const int firstChannel = mode == ChannelMode::MidSide ? 0 : slot;
+    const int lastChannel = mode == ChannelMode::MidSide ? numChannels - 1 : slot;
+
+    for (int channel = firstChannel; channel <= lastChannel; channel++)
+    {
+        float* dest = ring.getWritePointer (channel);
+        const float gain = mode == ChannelMode::MidSide ? gains[static_cast<size_t> (channel)] : 1.0f;
+
+        for (int i = begin; i < end; i++)
+        {
+            int index = frameStartIndex + i;
+            index = index >= ringSamples ? index - ringSamples : index;
+            dest[index] += gain * window[i] * data[i];
+        }
+    }
+}
@@ -0,0 +1,95 @@
+/*
+  ==============================================================================
+
+    SpectralStream.h
+
+    Streaming resynthesis of a freeze, an alternative to overlapping a few
+    freeze length grains. Short frames, a quarter of a frame apart, are
+    resynthesised from the freeze's magnitudes, summed down to the frame's
+    resolution, each with phases of its own. The next frame is worked on a
+    few units per sample while the current hop plays, so every block costs
+    about the same, whatever its size.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Fft.h"
+#include "GrainPool.h"
+#include "RandomPhaseSpectrum.h"
+#include "SampleBuffer.h"
+
+#include <cstdint>
+#include <vector>
+
+//==============================================================================
+/**
+*/
+class SpectralStream
+{
+public:
+    static constexpr int numOverlaps = 4;
+
+    //==============================================================================
+    // Allocates, so call this while audio isn't running. fft sets the frame
+    // size, window is a frame long and normalisation a hop long, the inverse
+    // of the overlapping windows' sum, and all three must outlive the stream.
+    void prepare (int numChannels, const Fft& fft, const float* window, const float* normalisation);
+
+    void setSeed (std::uint64_t newSeed) { seed = newSeed; }
+
+    // Audio thread. Silences the stream and starts it again, but keeps the
+    // spectrum, so it fades back in over a frame.
+    void reset();
+
+    // Audio thread. The magnitudes of the bins up to Nyquist of a freeze of
+    // 2^fftOrder samples, at least a frame long. Frames started after this
+    // follow the new spectrum.
+    void setSpectrum (const SampleBuffer& mags, int fftOrder, ChannelMode mode, const float* channelGains);
+
+    // Audio thread. Writes, or adds when accumulating, the next numSamples
+    // of every channel.
+    void process (const SampleBlock& buffer, int numChannels, int numSamples, bool accumulate);
+
+private:
+    //==============================================================================
+    // A frame is drawing its phases, then for each channel, or just the mid
+    // channel in mid/side, the inverse transform a pass at a time and adding
+    // the windowed result to the ring. Every task counts as a pass.
+    void startFrame();
+    void advance (int numSamples);
+    void runTask (int task, int beginUnit, int endUnit);
+    int getNumSlots() const { return mode == ChannelMode::MidSide ? 1 : numChannels; }
+    int getNumTasks() const { return 1 + getNumSlots() * (fft->getNumInversePasses() + 2); }
+
+    const Fft* fft = nullptr;
+    const float* window = nullptr;
+    const float* normalisation = nullptr;
+    int frameSize = 0;
+    int hop = 0;
+    int numBins = 0;
+    int numChannels = 0;
+
+    // the freeze's magnitudes at the frame's resolution
+    ChannelMode mode = ChannelMode::Independent;
+    SampleBuffer envelope;
+    std::vector<float> gains;
+    std::uint64_t generation = 0;
+
+    // the frame being worked on, and the frames already summed, a frame and
+    // a hop long so that the next frame never lands on the hop being played
+    SampleBuffer frameData;
+    SampleBuffer ring;
+    RandomPhaseSpectrum phases;
+    std::uint64_t seed = 0;
+    std::uint64_t frameSerial = 0;
+    int readIndex = 0;
+    int hopPosition = 0;
+    int frameStartIndex = 0;
+
+    int taskIndex = 0;
+    int taskUnit = 0;
+    std::int64_t credit = 0;
+    std::int64_t unitsPerSample = 0;
+};
@@ -0,0 +1,69 @@
+/*
+  ==============================================================================
+
+    SpscFifo.h
+
+    Bounded lock-free fifo for one producer thread and one consumer thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+//==============================================================================
+/**
+*/
+template <typename Item>
+class SpscFifo
+{
+public:
+    // allocates, so call this before either thread starts using the fifo
+    void reset (int capacity)
+    {
+        items.assign (static_cast<size_t> (capacity + 1), Item {});
+        readIndex.store (0);
+        writeIndex.store (0);
+    }
+
+    int getNumReady() const
+    {
+        const int size = static_cast<int> (items.size());
+        const int ready = writeIndex.load (std::memory_order_acquire) - readIndex.load (std::memory_order_acquire);
+        return ready < 0 ? ready + size : ready;
+    }
+
+    // producer thread
+    bool push (const Item& item)
+    {
+        const int write = writeIndex.load (std::memory_order_relaxed);
+        const int next = write + 1 == static_cast<int> (items.size()) ? 0 : write + 1;
+
+        if (next == readIndex.load (std::memory_order_acquire))
+            return false;
+
+        items[static_cast<size_t> (write)] = item;
+        writeIndex.store (next, std::memory_order_release);
+        return true;
+    }
+
+    // consumer thread
+    bool pop (Item& item)
+    {
+        const int read = readIndex.load (std::memory_order_relaxed);
+
+        if (read == writeIndex.load (std::memory_order_acquire))
+            return false;
+
+        item = items[static_cast<size_t> (read)];
+        readIndex.store (read + 1 == static_cast<int> (items.size()) ? 0 : read + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<Item> items { Item {} };
+    std::atomic<int> readIndex { 0 };
+    std::atomic<int> writeIndex { 0 };
+};
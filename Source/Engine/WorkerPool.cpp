@@ -0,0 +1,93 @@
+/*
+  ==============================================================================
+
+    WorkerPool.cpp
+
+  ==============================================================================
+*/
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+//==============================================================================
+WorkerPool::~WorkerPool()
+{
+    release();
+}
+
+void WorkerPool::prepare (int numThreads)
+{
+    release();
+
+    work = 0;
+    numItemsDone = 0;
+    shouldExit = false;
+
+    for (int i = 0; i < numThreads; i++)
+        threads.emplace_back ([this, i] { run (i); });
+}
+
+void WorkerPool::release()
+{
+    shouldExit = true;
+    wakeup.signal (getNumThreads());
+
+    for (auto& thread : threads)
+        thread.join();
+
+    threads.clear();
+}
+
+//==============================================================================
+bool WorkerPool::start (Task task, void* context, int numItems)
+{
+    if (threads.empty() || ! isFinished())
+        return false;
+
+    currentTask = task;
+    currentContext = context;
+    numItemsDone.store (0, std::memory_order_relaxed);
+
+    // publishes the task and context along with the new item count
+    work.store (static_cast<std::uint64_t> (numItems) << 32, std::memory_order_release);
+
+    // a thread that wakes to find the items already claimed just waits again
+    wakeup.signal (std::min (numItems, getNumThreads()));
+    return true;
+}
+
+bool WorkerPool::isFinished() const
+{
+    const auto numItems = static_cast<int> (work.load (std::memory_order_acquire) >> 32);
+    return numItemsDone.load (std::memory_order_acquire) == numItems;
+}
+
+void WorkerPool::waitUntilFinished() const
+{
+    while (! isFinished())
+        std::this_thread::yield();
+}
+
+//==============================================================================
+void WorkerPool::run (int threadIndex)
+{
+    while (! shouldExit)
+    {
+        auto current = work.load (std::memory_order_acquire);
+        const auto item = static_cast<int> (current & itemMask);
+        const auto numItems = static_cast<int> (current >> 32);
+
+        if (item >= numItems)
+        {
+            wakeup.wait();
+            continue;
+        }
+
+        if (work.compare_exchange_weak (current, current + 1, std::memory_order_acq_rel))
+        {
+            currentTask (currentContext, item, threadIndex);
+            numItemsDone.fetch_add (1, std::memory_order_release);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/*
+  ==============================================================================
+
+    WorkerPool.h
+
+    A few background threads that share out the items of one job at a time.
+    Starting a job and checking on it never blocks or allocates, so the audio
+    thread can hand work to the pool and pick up the result in a later block.
+    The threads sleep between jobs, and starting one wakes them.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Semaphore.h"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+//==============================================================================
+/**
+*/
+class WorkerPool
+{
+public:
+    // called once per item, threadIndex is in 0..getNumThreads() - 1
+    using Task = void (*) (void* context, int item, int threadIndex);
+
+    //==============================================================================
+    WorkerPool() = default;
+    ~WorkerPool();
+
+    // while no job is running
+    void prepare (int numThreads);
+    void release();
+    int getNumThreads() const { return static_cast<int> (threads.size()); }
+
+    // one thread at a time, and only once the previous job has finished
+    bool start (Task task, void* context, int numItems);
+    bool isFinished() const;
+
+    // yields until the job has finished, for offline renders
+    void waitUntilFinished() const;
+
+private:
+    //==============================================================================
+    void run (int threadIndex);
+
+    static constexpr std::uint64_t itemMask = 0xffffffffu;
+
+    std::vector<std::thread> threads;
+    Semaphore wakeup;
+    std::atomic<bool> shouldExit { false };
+
+    // The item count and the next unclaimed item share one word, so a thread
+    // can only ever claim an item of the job that is currently running.
+    std::atomic<std::uint64_t> work { 0 };
+    std::atomic<int> numItemsDone { 0 };
+    Task currentTask = nullptr;
+    void* currentContext = nullptr;
+
+    //==============================================================================
+    WorkerPool (const WorkerPool&) = delete;
+    WorkerPool& operator= (const WorkerPool&) = delete;
+};
@@ -16,7 +16,8 @@ AutoFreezeAudioProcessorEditor::AutoFreezeAudioProcessorEditor (AutoFreezeAudioP
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
     int fps = 30;
-    setSize (400, 300);
+    setOpaque(true);
+    setSize (400, 420);
     startTimerHz(fps);
     
     // Initialize the dbLevel smoothing
@@ -31,33 +32,48 @@ AutoFreezeAudioProcessorEditor::~AutoFreezeAudioProcessorEditor()
 //==============================================================================
 void AutoFreezeAudioProcessorEditor::paint (juce::Graphics& g)
 {
-    // (Our component is opaque, so we must completely fill the background with a solid colour)
-    g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
+    // The background, meter box and spectrum frame never change, and the
+    // graphics context is already clipped to whatever was repainted
+    g.drawImage(background, getLocalBounds().toFloat());
 
     // Add level text
     g.setColour(juce::Colours::wheat);
     g.setFont(juce::FontOptions (15.0f));
-    g.drawText(juce::String(displayDbLevel.getCurrentValue(), 2), levelTextRect, juce::Justification::centred, 1);
+
+    if (g.clipRegionIntersects(levelTextRect.toNearestInt()))
+        g.drawText(levelText, levelTextRect, juce::Justification::centred, 1);
+
+    // Add status text
+    if (g.clipRegionIntersects(statusTextRect.toNearestInt()))
+        g.drawText(statusText, statusTextRect, juce::Justification::centred, 1);
     
-    // Draw meter level
+    // Draw meter level, inside the meter box
     g.setColour(juce::Colours::thistle);
     g.fillRect(meterLevelRect);
-    
-    // Draw meter bounding box
-    g.setColour(juce::Colours::wheat);
-    g.drawRect(meterBoundsRect);
+
+    // Draw the freeze spectrum
+    if (g.clipRegionIntersects(spectrumRect.toNearestInt()))
+    {
+        g.setColour(juce::Colours::thistle);
+        g.strokePath(spectrumPath, juce::PathStrokeType(1.0f));
+    }
 }
 
 void AutoFreezeAudioProcessorEditor::resized()
 {
     // This is generally where you'll want to lay out the positions of any
     // subcomponents in your editor..
+
+    // Position the spectrum along the bottom
+    int spectrumHeight = 120;
+    int margin = 10;
+    spectrumRect.setBounds(margin, getHeight() - spectrumHeight - margin, getWidth() - 2 * margin, spectrumHeight);
     
-    // Position the meter
+    // Position the meter, centred above the spectrum
     int meterWidth = 50;
     int meterHeight = 200;
     int meterX = (getWidth() - meterWidth) / 2;
-    int meterY = (getHeight() - meterHeight) / 2;
+    int meterY = (spectrumRect.getY() - margin - meterHeight) / 2;
     meterBoundsRect.setBounds(meterX, meterY, meterWidth, meterHeight);
     
     // Position the level text
@@ -66,12 +82,61 @@ void AutoFreezeAudioProcessorEditor::resized()
     int levelTextX = meterBoundsRect.getCentreX() - levelTextWidth / 2;
     int levelTextY = meterBoundsRect.getY() - levelTextHeight;
     levelTextRect.setBounds(levelTextX, levelTextY, levelTextWidth, levelTextHeight);
-    
+
+    // Position the status text
+    statusTextRect.setBounds(0, meterBoundsRect.getBottom(), getWidth(), levelTextHeight);
+
+    renderBackground();
+    updateSpectrumPath();
+}
+
+void AutoFreezeAudioProcessorEditor::renderBackground()
+{
+    // rendered at the display's scale, so it stays sharp on high DPI screens
+    const float scale = juce::Component::getApproximateScaleFactorForComponent(this);
+    background = juce::Image(juce::Image::RGB, juce::jmax(1, juce::roundToInt(getWidth() * scale)),
+                             juce::jmax(1, juce::roundToInt(getHeight() * scale)), false);
+
+    juce::Graphics g(background);
+    g.addTransform(juce::AffineTransform::scale(scale));
+    g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
+
+    // Draw meter bounding box
+    g.setColour(juce::Colours::wheat);
+    g.drawRect(meterBoundsRect);
+
+    // Draw spectrum frame
+    g.drawRect(spectrumRect);
+}
+
+void AutoFreezeAudioProcessorEditor::updateSpectrumPath()
+{
+    // the points are already spaced on a log scale, so they're spread evenly
+    const auto area = spectrumRect.reduced(1.0f);
+    spectrumPath.clear();
+
+    if (spectrumView.serial == 0)
+        return;
+
+    for (int point = 0; point < AutoFreezeSpectrumView::numPoints; point++)
+    {
+        float x = area.getX() + area.getWidth() * point / (AutoFreezeSpectrumView::numPoints - 1);
+        float db = juce::jlimit(minDisplaySpectrumDb, maxDisplaySpectrumDb, spectrumView.dbLevels[point]);
+        float y = juce::jmap(db, minDisplaySpectrumDb, maxDisplaySpectrumDb, area.getBottom(), area.getY());
+
+        if (point == 0)
+            spectrumPath.startNewSubPath(x, y);
+        else
+            spectrumPath.lineTo(x, y);
+    }
 }
 
 void AutoFreezeAudioProcessorEditor::timerCallback()
 {
-    float currentDbLevel = audioProcessor.getDbLevel();
+    // Drain the telemetry published since the last tick, keeping the newest frame
+    while (audioProcessor.popTelemetry(latestTelemetry)) {}
+
+    float currentDbLevel = juce::Decibels::gainToDecibels(latestTelemetry.outputEnvelope, -100.0f);
     float limitedCurrentDbLevel = juce::jlimit(minDisplayDbLevel, maxDisplayDbLevel, currentDbLevel);
     
     if (limitedCurrentDbLevel > displayDbLevel.getNextValue()) {
@@ -81,12 +146,39 @@ void AutoFreezeAudioProcessorEditor::timerCallback()
     }
     
     // Calculate meter level position
-    int meterLevelWidth = meterBoundsRect.getWidth();
-    int meterLevelHeight = juce::jmap(displayDbLevel.getNextValue(), minDisplayDbLevel, maxDisplayDbLevel, 0.0f, meterBoundsRect.getHeight());
-    int meterLevelX = meterBoundsRect.getX();
-    int meterLevelY = meterBoundsRect.getBottom() - meterLevelHeight;
-    meterLevelRect.setBounds(meterLevelX, meterLevelY, meterLevelWidth, meterLevelHeight);
-    
-    repaint();
-}
+    int meterLevelWidth = meterBoundsRect.getWidth() - 2;
+    int meterLevelHeight = juce::jmap(displayDbLevel.getNextValue(), minDisplayDbLevel, maxDisplayDbLevel, 0.0f, meterBoundsRect.getHeight() - 2);
+    int meterLevelX = meterBoundsRect.getX() + 1;
+    int meterLevelY = meterBoundsRect.getBottom() - 1 - meterLevelHeight;
+    juce::Rectangle<float> newMeterLevelRect(meterLevelX, meterLevelY, meterLevelWidth, meterLevelHeight);
 
+    // Repaint only what has changed
+    if (newMeterLevelRect != meterLevelRect) {
+        repaint(meterLevelRect.getUnion(newMeterLevelRect).getSmallestIntegerContainer());
+        meterLevelRect = newMeterLevelRect;
+    }
+
+    auto newLevelText = juce::String(displayDbLevel.getCurrentValue(), 2);
+
+    if (newLevelText != levelText) {
+        levelText = newLevelText;
+        repaint(levelTextRect.getSmallestIntegerContainer());
+    }
+
+    auto loadPercent = 100.0f * latestTelemetry.maxProcessingSeconds / juce::jmax(latestTelemetry.budgetSeconds, 1.0e-6f);
+    auto newStatusText = juce::String(getStateName(latestTelemetry.state))
+                       + "  |  overruns " + juce::String(latestTelemetry.overruns)
+                       + "  |  peak load " + juce::String(loadPercent, 1) + "%";
+
+    if (newStatusText != statusText) {
+        statusText = newStatusText;
+        repaint(statusTextRect.getSmallestIntegerContainer());
+    }
+
+    // The spectrum only arrives when the freeze changes, already reduced to
+    // a few hundred points on the audio thread
+    if (audioProcessor.getSpectrumView(spectrumView)) {
+        updateSpectrumPath();
+        repaint(spectrumRect.getSmallestIntegerContainer());
+    }
+}
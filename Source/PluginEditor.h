@@ -26,17 +26,34 @@ public:
     void timerCallback() override;
 
 private:
+    // Only the parts that change are repainted, over a cached image of the
+    // parts that don't, so an idle editor costs next to nothing.
+    void renderBackground();
+    void updateSpectrumPath();
+
     static constexpr float minDisplayDbLevel = -60.0f;
     static constexpr float maxDisplayDbLevel = 0.0f;
+    static constexpr float minDisplaySpectrumDb = -90.0f;
+    static constexpr float maxDisplaySpectrumDb = 0.0f;
     
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     AutoFreezeAudioProcessor& audioProcessor;
     juce::SmoothedValue<float> displayDbLevel;
     
+    AutoFreezeTelemetry latestTelemetry;
+    AutoFreezeSpectrumView spectrumView;
+
+    juce::Image background;
+    juce::String levelText;
+    juce::String statusText;
+    juce::Path spectrumPath;
+
     juce::Rectangle<float> levelTextRect;
+    juce::Rectangle<float> statusTextRect;
     juce::Rectangle<float> meterBoundsRect;
     juce::Rectangle<float> meterLevelRect;
+    juce::Rectangle<float> spectrumRect;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AutoFreezeAudioProcessorEditor)
 };
@@ -8,6 +8,7 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "AllocationGuard.h"
 
 //==============================================================================
 AutoFreezeAudioProcessor::AutoFreezeAudioProcessor()
@@ -19,15 +20,58 @@ AutoFreezeAudioProcessor::AutoFreezeAudioProcessor()
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
-                       )
+                       ),
+#else
+     :
 #endif
+       parameters (*this, nullptr, "AutoFreeze", createParameterLayout())
 {
+    thresholdParameter = parameters.getRawParameterValue ("threshold");
+    predelayParameter = parameters.getRawParameterValue ("predelay");
+    cooldownParameter = parameters.getRawParameterValue ("cooldown");
+    shortFadeParameter = parameters.getRawParameterValue ("shortFade");
+    longFadeParameter = parameters.getRawParameterValue ("longFade");
+    morphParameter = parameters.getRawParameterValue ("morph");
+    snapshotParameter = parameters.getRawParameterValue ("snapshot");
 }
 
 AutoFreezeAudioProcessor::~AutoFreezeAudioProcessor()
 {
 }
 
+juce::AudioProcessorValueTreeState::ParameterLayout AutoFreezeAudioProcessor::createParameterLayout()
+{
+    using Engine = AutoFreezeEngine;
+
+    const auto seconds = juce::AudioParameterFloatAttributes().withLabel ("s");
+    const auto decibels = juce::AudioParameterFloatAttributes().withLabel ("dB");
+
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+
+    layout.add (std::make_unique<juce::AudioParameterFloat> (juce::ParameterID { "threshold", 1 }, "Threshold",
+                                                             juce::NormalisableRange<float> (Engine::minThresholdDb, Engine::maxThresholdDb, 0.1f),
+                                                             Engine::defaultThresholdDb, decibels));
+    layout.add (std::make_unique<juce::AudioParameterFloat> (juce::ParameterID { "predelay", 1 }, "Predelay",
+                                                             juce::NormalisableRange<float> (0.0f, Engine::maxPredelaySeconds, 0.001f, 0.5f),
+                                                             Engine::defaultPredelaySeconds, seconds));
+    layout.add (std::make_unique<juce::AudioParameterFloat> (juce::ParameterID { "cooldown", 1 }, "Cooldown",
+                                                             juce::NormalisableRange<float> (Engine::minCooldownSeconds, Engine::maxCooldownSeconds, 0.01f, 0.4f),
+                                                             Engine::defaultCooldownSeconds, seconds));
+    layout.add (std::make_unique<juce::AudioParameterFloat> (juce::ParameterID { "shortFade", 1 }, "Short Fade",
+                                                             juce::NormalisableRange<float> (Engine::minFadeSeconds, Engine::maxShortFadeSeconds, 0.001f, 0.4f),
+                                                             Engine::defaultShortFadeSeconds, seconds));
+    layout.add (std::make_unique<juce::AudioParameterFloat> (juce::ParameterID { "longFade", 1 }, "Long Fade",
+                                                             juce::NormalisableRange<float> (Engine::minFadeSeconds, Engine::maxLongFadeSeconds, 0.001f, 0.4f),
+                                                             Engine::defaultLongFadeSeconds, seconds));
+    layout.add (std::make_unique<juce::AudioParameterFloat> (juce::ParameterID { "morph", 1 }, "Morph Time",
+                                                             juce::NormalisableRange<float> (0.0f, Engine::maxMorphSeconds, 0.01f, 0.4f),
+                                                             0.0f, seconds));
+    layout.add (std::make_unique<juce::AudioParameterInt> (juce::ParameterID { "snapshot", 1 }, "Snapshot",
+                                                           0, FreezeBank::maxNumSnapshots, 0));
+
+    return layout;
+}
+
 //==============================================================================
 const juce::String AutoFreezeAudioProcessor::getName() const
 {
@@ -63,7 +107,7 @@ bool AutoFreezeAudioProcessor::isMidiEffect() const
 
 double AutoFreezeAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return engine.getTailLengthSeconds();
 }
 
 int AutoFreezeAudioProcessor::getNumPrograms()
@@ -91,80 +135,17 @@ void AutoFreezeAudioProcessor::changeProgramName (int index, const juce::String&
 }
 
 //==============================================================================
-int roundToMultiple (int unRoundedNumber, int multiple)
-{
-    return static_cast<int>(std::round(static_cast<float>(unRoundedNumber) / multiple)) * multiple;
-}
-
-void generateFade (std::vector<float>& fade, bool fadeIn, int size)
-{
-    fade.resize(size);
-    
-    for (int i = 0; i < size; i++)
-    {
-        float x = static_cast<float>(i) / size * (M_PI / 2);
-        
-        if (fadeIn) fade[i] = std::sin(x);
-        else fade[i] = std::cos(x);
-    }
-}
-
 void AutoFreezeAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    const int channels = getTotalNumInputChannels();
-    
-    currentState = AutoFreezeState::BelowThreshold;
-    
-    // freeze buffer
-    freezeBuffer.setSize(channels, freezeBufferSamples);
-    freezeBuffer.clear();
-    juce::dsp::WindowingFunction<float> freezeWindowingFunction =
-        juce::dsp::WindowingFunction<float>(freezeBufferSamples, juce::dsp::WindowingFunction<float>::hann);
-    freezeWindow.resize(freezeBufferSamples);
-    std::fill(freezeWindow.begin(), freezeWindow.end(), 1.0f);
-    freezeWindowingFunction.multiplyWithWindowingTable(freezeWindow.data(), freezeBufferSamples);
-    freezeBufferIndex = 0;
-        
-    // grains
-    grainTargetsRms.resize(channels);
-    std::fill(grainTargetsRms.begin(), grainTargetsRms.end(), 0.0f);
-    freezeMags.setSize(channels, freezeBufferSamples);
-    freezeMags.clear();
-    
-    for (int i = 0; i < numGrains; i++)
-    {
-        auto& grain = grains[i];
-        grain.setSize(channels, freezeBufferSamples);
-        grain.clear();
-        grainIndices[i] = freezeBufferSamples / 4 * i;
-    }
-    
-    // predelay
-    predelaySamples = roundToMultiple(predelaySeconds * sampleRate, samplesPerBlock);
-    predelayCounter = 0;
-    
-    // cooldown
-    cooldownSamples = roundToMultiple(cooldownSeconds * sampleRate, samplesPerBlock);
-    coolDownCounter = 0;
-    
-    // short fade
-    shortFadeSamples = roundToMultiple(shortFadeSeconds * sampleRate, samplesPerBlock);
-    generateFade(shortFadeIn, true, shortFadeSamples);
-    generateFade(shortFadeOut, false, shortFadeSamples);
-    shortFadeIndex = 0;
-    
-    // long fade
-    longFadeSamples = roundToMultiple(longFadeSeconds * sampleRate, samplesPerBlock);
-    generateFade(longFadeIn, true, longFadeSamples);
-    generateFade(longFadeOut, false, longFadeSamples);
-    longFadeIndex = 0;
+    updateEngineParameters();
+    engine.prepare(sampleRate, samplesPerBlock, getTotalNumInputChannels());
 }
 
 void AutoFreezeAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
-    freezeBuffer.setSize(0, 0);
+    engine.release();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -174,12 +155,11 @@ bool AutoFreezeAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Any layout is supported, from mono up to surround and ambisonic stems,
+    // as long as the engine can address all of its channels at once.
+    const auto& outputSet = layouts.getMainOutputChannelSet();
+
+    if (outputSet.isDisabled() || outputSet.size() > SampleBlock::maxChannels)
         return false;
 
     // This checks if the input layout matches the output layout
@@ -195,328 +175,126 @@ bool AutoFreezeAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
 
 void AutoFreezeAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
-    auto startTime = juce::Time::getMillisecondCounterHiRes();
-    juce::ScopedNoDenormals noDenormals;
-    auto totalNumInputChannels  = getTotalNumInputChannels();
-    auto totalNumOutputChannels = getTotalNumOutputChannels();
-
-    // In case we have more outputs than inputs, this code clears any output
-    // channels that didn't contain input data, (because these aren't
-    // guaranteed to be empty - they may contain garbage).
-    // This is here to avoid people getting screaming feedback
-    // when they first compile a plugin, but obviously you don't need to keep
-    // this code if your algorithm always overwrites all the output channels.
-    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
-        buffer.clear (i, 0, buffer.getNumSamples());
-    
-    // This is the place where you'd normally do the guts of your plugin's
-    // audio processing...
-    // Make sure to reset the state if your inner loop is processing
-    // the samples and the outer loop is handling the channels.
-    // Alternatively, you can process the samples with the channels
-    // interleaved by keeping the same state.
-    updateState(buffer);
-    
-    std::string stateString;
-    
-    switch (currentState) {
-        case AutoFreezeState::BelowThreshold:
-            processBelowThreshold(buffer);
-            stateString = "Below Threshold";
-            break;
-        case AutoFreezeState::Predelay:
-            processPredelay(buffer);
-            stateString = "Predelay";
-            break;
-        case AutoFreezeState::ReadingFreeze:
-            processReadingFreeze(buffer);
-            stateString = "Reading Freeze";
-            break;
-        case AutoFreezeState::Cooldown:
-            stateString = "Cooldown";
-            processCooldown(buffer);
-            break;
-    }
-    
-    //DBG(stateString);
-    
-    float channelTotalRms = 0.0f;
-    
-    for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
-        channelTotalRms += buffer.getRMSLevel(channel, 0, buffer.getNumSamples());
-    }
-    
-    float averageRms = channelTotalRms / buffer.getNumChannels();
-    dbLevel = juce::Decibels::gainToDecibels(averageRms);
-    
-    auto endTime = juce::Time::getMillisecondCounterHiRes();
-    double processingTime = endTime - startTime;
-    double blockTime = buffer.getNumSamples() / getSampleRate() * 1000;
-    
-    if (blockTime < processingTime)
-        DBG("could not process block in time");
-}
-
-std::vector<float> getChannelsRms(const juce::AudioBuffer<float>& buffer) {
-    int numChannels = buffer.getNumChannels();
-    int numSamples = buffer.getNumSamples();
-
-    std::vector<float> channelsRms = std::vector<float>(numChannels);
-    
-    for (int channel = 0; channel < numChannels; channel++) {
-        channelsRms[channel] = buffer.getRMSLevel(channel, 0, numSamples);
-    }
-    
-    return channelsRms;
-}
-
-float getChannelAveragedRms(const juce::AudioBuffer<float>& buffer)
-{
-    float rmsSum = 0.0f;
-    std::vector<float> channelsRms = getChannelsRms(buffer);
-    
-    for (float channelRms : channelsRms)
     {
-        rmsSum += channelRms;
-    }
-    
-    return rmsSum / buffer.getNumChannels();
-}
-
-void AutoFreezeAudioProcessor::calculateFreezeMagnitudes()
-{
-    for (int channel = 0; channel < freezeBuffer.getNumChannels(); channel++)
-    {
-        std::vector<float> fftData(freezeBufferSamples * 2, 0.0f);
-        
-        const float* channelFreezeData = freezeBuffer.getReadPointer(0);
-        for (int sample = 0; sample < freezeBufferSamples; sample++) {
-            fftData[sample] = channelFreezeData[sample] * freezeWindow[sample];
-        }
+        ScopedAllocationGuard allocationGuard;
+        juce::ScopedNoDenormals noDenormals;
+        auto totalNumInputChannels  = getTotalNumInputChannels();
+        auto totalNumOutputChannels = getTotalNumOutputChannels();
         
-        freezeFft.performFrequencyOnlyForwardTransform(fftData.data(), true);
+        // In case we have more outputs than inputs, this code clears any output
+        // channels that didn't contain input data, (because these aren't
+        // guaranteed to be empty - they may contain garbage).
+        // This is here to avoid people getting screaming feedback
+        // when they first compile a plugin, but obviously you don't need to keep
+        // this code if your algorithm always overwrites all the output channels.
+        for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
+            buffer.clear (i, 0, buffer.getNumSamples());
         
-        float* channelMagData = freezeMags.getWritePointer(channel);
-        for (int sample = 0; sample < freezeBufferSamples; sample++)
-        {
-            channelMagData[sample] = fftData[sample];
-        }
+        engine.setNonRealtime(isNonRealtime());
+        updateEngineParameters();
+        recallSnapshots(midiMessages);
+        engine.process(buffer.getArrayOfWritePointers(), totalNumInputChannels, buffer.getNumSamples());
     }
 }
 
-void AutoFreezeAudioProcessor::readIntoGrain(int grainNum)
+// only atomic loads and stores, so automation never reprepares or allocates
+void AutoFreezeAudioProcessor::updateEngineParameters()
 {
-    if (grainNum < 0 || grainNum >= numGrains)
-    {
-        throw std::runtime_error("Cannot read into non-existent grain");
-    }
-    
-    std::vector<float> randomPhases(freezeBufferSamples / 2);
-    juce::Random random;
-    
-    for (int sample = 0; sample < freezeBufferSamples / 2; sample++)
-    {
-        randomPhases[sample] = random.nextFloat() * juce::MathConstants<float>::twoPi;
-    }
-    
-    for (int channel = 0; channel < freezeBuffer.getNumChannels(); channel++)
-    {
-        std::vector<float> ifftData(2 * freezeBufferSamples, 0.0f);
-        const float* magData = freezeMags.getReadPointer(channel);
-                
-        // DC & Nyquist handling
-        ifftData[0] = magData[0];
-        ifftData[1] = 0.0f;
-        ifftData[freezeBufferSamples] = magData[freezeBufferSamples / 2];
-        ifftData[freezeBufferSamples] = 0.0f;
-        
-        for (int bin = 1; bin < freezeBufferSamples / 2; bin++) {
-            float real = magData[bin] * std::cos(randomPhases[bin]);
-            float imag = magData[bin] * std::sin(randomPhases[bin]);
-            ifftData[bin * 2] = real;
-            ifftData[bin * 2 + 1] = imag;
-        }
-    
-        freezeFft.performRealOnlyInverseTransform(ifftData.data());
-        
-        float* grainChannelData = grains[grainNum].getWritePointer(channel);
-        std::memcpy(grainChannelData, ifftData.data(), freezeBufferSamples * sizeof(float));
-    }
+    engine.setThresholdDb(thresholdParameter->load());
+    engine.setPredelaySeconds(predelayParameter->load());
+    engine.setCooldownSeconds(cooldownParameter->load());
+    engine.setShortFadeSeconds(shortFadeParameter->load());
+    engine.setLongFadeSeconds(longFadeParameter->load());
+    engine.setMorphSeconds(morphParameter->load());
 }
 
-void AutoFreezeAudioProcessor::updateState(juce::AudioBuffer<float>& buffer)
+// the engine decides what to recall, so the real-time check covers it too
+void AutoFreezeAudioProcessor::recallSnapshots (const juce::MidiBuffer& midiMessages)
 {
-    switch(currentState)
-    {
-        case AutoFreezeState::BelowThreshold: {
-            float rms = getChannelAveragedRms(buffer);
-            float rmsDb = juce::Decibels::gainToDecibels(rms);
-            
-            if (rmsDb > freezeThresholdDb) {
-                currentState = AutoFreezeState::Predelay;
-                predelayCounter = 0;
-                shortFadeIndex = 0;
-            }
-            
-            break;
-        }
-        case AutoFreezeState::Predelay: {
-            if (predelayCounter >= predelaySamples) {
-                currentState = AutoFreezeState::ReadingFreeze;
-                freezeBufferIndex = 0;
-            }
-            
-            break;
-        }
-        case AutoFreezeState::ReadingFreeze:
-            if (freezeBufferIndex >= freezeBufferSamples) {
-                currentState = AutoFreezeState::Cooldown;
-                coolDownCounter = 0;
-                longFadeIndex = 0;
-                grainTargetsRms = getChannelsRms(buffer);
-                calculateFreezeMagnitudes();
-                
-                for (int i = 0; i < numGrains; i ++) {
-                    readIntoGrain(i);
-                    grainIndices[i] = round(freezeBufferSamples / numGrains * i);
-                }
-            }
-            
-            break;
-        case AutoFreezeState::Cooldown:
-            if (coolDownCounter >= cooldownSamples) {
-                currentState = AutoFreezeState::BelowThreshold;
-            }
-            
-            break;
-    }
-}
+    engine.setSnapshotParameter(static_cast<int>(snapshotParameter->load()));
 
-juce::AudioBuffer<float> AutoFreezeAudioProcessor::readFreeze(int numChannels, int blockSize)
-{
-    juce::AudioBuffer<float> buffer(numChannels, blockSize);
-    buffer.clear();
-
-     
-    // overlap-add grains into the buffer
-    for (int sample = 0; sample < buffer.getNumSamples(); sample++) {
-        // re-read freeze into grains that have been fully read from
-        for (int grainNum = 0; grainNum < numGrains; grainNum++)
-        {
-            if (grainIndices[grainNum] >= freezeBufferSamples) {
-                readIntoGrain(grainNum);
-                grainIndices[grainNum] = 0;
-            }
-        }
-        
-        for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
-            float windowSum = 0.0f;
-            float* channelData = buffer.getWritePointer(channel);
-            
-            for (int grainNum = 0; grainNum < numGrains; grainNum++) {
-                const float* grainChannelData = grains[grainNum].getReadPointer(channel);
-                int grainIndex = grainIndices[grainNum];
-                float windowValue = freezeWindow[grainIndex];
-                
-                channelData[sample] += grainChannelData[grainIndex] * windowValue;
-                windowSum += windowValue;
-            }
-            
-            if (windowSum != 0.0f)
-            {
-                channelData[sample] /= windowSum;
-            }
-        }
-        
-        for (int grainNum = 0; grainNum < numGrains; grainNum++) {
-            grainIndices[grainNum]++;
-        }
-    }
-    
-    return buffer;
+    for (const auto metadata : midiMessages)
+        engine.handleMidiMessage(metadata.data, metadata.numBytes);
 }
 
-void AutoFreezeAudioProcessor::processBelowThreshold(juce::AudioBuffer<float>& buffer)
+//==============================================================================
+bool AutoFreezeAudioProcessor::loadSnapshotBank (const juce::File& bankFile)
 {
-    juce::AudioBuffer<float> freeze = readFreeze(buffer.getNumChannels(), buffer.getNumSamples());
-        
-    for (int channel = 0; channel < buffer.getNumChannels(); channel++)
-    {
-        buffer.copyFrom(channel, 0, freeze, channel, 0, buffer.getNumSamples());
-    }
+    // the engine lets go of the old bank before it's unmapped
+    engine.setSnapshotBank(nullptr, 0);
+    snapshotBankMap.reset();
+    snapshotBankFile = juce::File();
+
+    auto map = std::make_unique<juce::MemoryMappedFile>(bankFile, juce::MemoryMappedFile::readOnly);
+
+    if (map->getData() == nullptr || ! engine.setSnapshotBank(map->getData(), map->getSize()))
+        return false;
+
+    snapshotBankMap = std::move(map);
+    snapshotBankFile = bankFile;
+    return true;
 }
 
-void AutoFreezeAudioProcessor::processPredelay(juce::AudioBuffer<float>& buffer)
+bool AutoFreezeAudioProcessor::addSnapshotToBank (const juce::File& bankFile)
 {
-    juce::AudioBuffer<float> freeze = readFreeze(buffer.getNumChannels(), buffer.getNumSamples());
-    
-    for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+    std::vector<std::uint8_t> freezeData;
+
+    if (! engine.getFreezeState(freezeData, freezeStateEncoding))
+        return false;
+
+    if (bankFile.existsAsFile() && bankFile != snapshotBankFile && ! loadSnapshotBank(bankFile))
+        return false;
+
+    // the snapshots already in the bank are copied straight out of the mapping
+    std::vector<const void*> snapshots;
+    std::vector<std::size_t> snapshotSizes;
+    const auto& bank = engine.getSnapshotBank();
+
+    for (int index = 0; bankFile == snapshotBankFile && index < bank.getNumSnapshots(); index++)
     {
-        float* bufferChannelData = buffer.getWritePointer(channel);
-        const float* freezeChannelData = freeze.getReadPointer(channel);
-        
-        for (int sample = 0; sample < buffer.getNumSamples(); sample++)
+        const void* snapshotData;
+        std::size_t numBytes;
+
+        if (bank.getSnapshot(index, snapshotData, numBytes))
         {
-            float fade_in_factor = 1;
-            float fade_out_factor = 0;
-            
-            if (shortFadeIndex < shortFadeSamples)
-            {
-                fade_in_factor = shortFadeIn[shortFadeIndex + sample];
-                fade_out_factor = shortFadeOut[shortFadeIndex + sample];
-            }
-                        
-            float faded_in_dry = bufferChannelData[sample] * fade_in_factor;
-            float faded_out_wet = freezeChannelData[sample] * fade_out_factor;
-            
-            bufferChannelData[sample] = faded_in_dry + faded_out_wet;
-            
+            snapshots.push_back(snapshotData);
+            snapshotSizes.push_back(numBytes);
         }
     }
-    
-    predelayCounter += buffer.getNumSamples();
-    shortFadeIndex += buffer.getNumSamples();
-}
 
-void AutoFreezeAudioProcessor::processReadingFreeze(juce::AudioBuffer<float>& buffer)
-{
-    for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
-        freezeBuffer.copyFrom(channel, freezeBufferIndex, buffer, channel, 0, buffer.getNumSamples());
-    }
-    
-    freezeBufferIndex += buffer.getNumSamples();
-}
+    if (static_cast<int>(snapshots.size()) >= FreezeBank::maxNumSnapshots)
+        return false;
+
+    snapshots.push_back(freezeData.data());
+    snapshotSizes.push_back(freezeData.size());
+
+    std::vector<std::uint8_t> index;
+    FreezeBank::writeIndex(snapshotSizes, index);
+
+    juce::TemporaryFile tempFile(bankFile);
 
-void AutoFreezeAudioProcessor::processCooldown(juce::AudioBuffer<float>& buffer)
-{
-    juce::AudioBuffer<float> freeze = readFreeze(buffer.getNumChannels(), buffer.getNumSamples());
-    
-    for (int channel = 0; channel < buffer.getNumChannels(); channel++)
     {
-        float* bufferChannelData = buffer.getWritePointer(channel);
-        const float* freezeChannelData = freeze.getReadPointer(channel);
-        
-        for (int sample = 0; sample < buffer.getNumSamples(); sample++)
-        {
-            float fade_in_factor = 1;
-            float fade_out_factor = 0;
-            
-            if (longFadeIndex < shortFadeSamples)
-            {
-                fade_in_factor = longFadeIn[longFadeIndex + sample];
-                fade_out_factor = longFadeOut[longFadeIndex + sample];
-            }
-                        
-            float faded_in_wet = freezeChannelData[sample] * fade_in_factor;
-            float faded_out_dry = bufferChannelData[sample] * fade_out_factor;
-            
-            bufferChannelData[sample] = faded_in_wet + faded_out_dry;
-            
-        }
+        juce::FileOutputStream stream(tempFile.getFile());
+
+        if (! stream.openedOk())
+            return false;
+
+        stream.write(index.data(), index.size());
+
+        for (size_t i = 0; i < snapshots.size(); i++)
+            stream.write(snapshots[i], snapshotSizes[i]);
+
+        stream.flush();
+
+        if (stream.getStatus().failed())
+            return false;
     }
-    
-    coolDownCounter += buffer.getNumSamples();
-    longFadeIndex += buffer.getNumSamples();
+
+    // a mapped file can't always be replaced, so the bank is mapped again afterwards
+    engine.setSnapshotBank(nullptr, 0);
+    snapshotBankMap.reset();
+    const bool replaced = tempFile.overwriteTargetFileWithTemporary();
+    return loadSnapshotBank(bankFile) && replaced;
 }
 
 //==============================================================================
@@ -533,15 +311,68 @@ juce::AudioProcessorEditor* AutoFreezeAudioProcessor::createEditor()
 //==============================================================================
 void AutoFreezeAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
+    juce::MemoryBlock parameterData;
+    auto state = parameters.copyState();
+    state.setProperty("snapshotBank", snapshotBankFile.getFullPathName(), nullptr);
+
+    if (auto xml = state.createXml())
+        copyXmlToBinary(*xml, parameterData);
+
+    // left empty if nothing has been frozen yet
+    std::vector<std::uint8_t> freezeData;
+    engine.getFreezeState(freezeData, freezeStateEncoding);
+
+    juce::MemoryOutputStream stream(destData, false);
+    stream.writeInt(stateMagic);
+    stream.writeInt(stateVersion);
+    stream.writeInt(static_cast<int>(parameterData.getSize()));
+    stream.write(parameterData.getData(), parameterData.getSize());
+    stream.writeInt(static_cast<int>(freezeData.size()));
+    stream.write(freezeData.data(), freezeData.size());
 }
 
 void AutoFreezeAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+    juce::MemoryInputStream stream(data, static_cast<size_t>(sizeInBytes), false);
+
+    // earlier sessions only saved the parameters
+    if (sizeInBytes < 12 || stream.readInt() != stateMagic || stream.readInt() > stateVersion)
+    {
+        restoreParameters(data, sizeInBytes);
+        return;
+    }
+
+    const auto* bytes = static_cast<const char*>(data);
+    const int parameterBytes = stream.readInt();
+
+    if (parameterBytes < 0 || parameterBytes > stream.getNumBytesRemaining())
+        return;
+
+    restoreParameters(bytes + stream.getPosition(), parameterBytes);
+    stream.skipNextBytes(parameterBytes);
+
+    // the bank comes back, but the saved freeze wins over its snapshot
+    const juce::String bankPath = parameters.state.getProperty("snapshotBank");
+
+    if (juce::File::isAbsolutePath(bankPath) && juce::File(bankPath) != snapshotBankFile)
+        loadSnapshotBank(juce::File(bankPath));
+
+    engine.setSnapshotParameter(static_cast<int>(snapshotParameter->load()), false);
+
+    if (stream.getNumBytesRemaining() < 4)
+        return;
+
+    const int freezeBytes = stream.readInt();
+
+    if (freezeBytes > 0 && freezeBytes <= stream.getNumBytesRemaining())
+        engine.restoreFreezeState(bytes + stream.getPosition(), static_cast<size_t>(freezeBytes));
+}
+
+void AutoFreezeAudioProcessor::restoreParameters (const void* data, int sizeInBytes)
+{
+    if (auto xml = getXmlFromBinary(data, sizeInBytes))
+        if (xml->hasTagName(parameters.state.getType()))
+            parameters.replaceState(juce::ValueTree::fromXml(*xml));
 }
 
 //==============================================================================
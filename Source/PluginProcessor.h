@@ -9,19 +9,12 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "Engine/AutoFreezeEngine.h"
 
 //==============================================================================
 /**
  
 */
-enum class AutoFreezeState
-{
-    BelowThreshold,
-    Predelay,
-    ReadingFreeze,
-    Cooldown
-};
-
 class AutoFreezeAudioProcessor  : public juce::AudioProcessor
 {
 public:
@@ -63,67 +56,70 @@ public:
     void setStateInformation (const void* data, int sizeInBytes) override;
     
     //==============================================================================
-    float getDbLevel () { return dbLevel; };
-    void updateState (juce::AudioBuffer<float>&);
-    void readIntoGrain(int grainNum);
-    void calculateFreezeMagnitudes();
-    juce::AudioBuffer<float> readFreeze(int numChannels, int blockSize);
-    void processBelowThreshold(juce::AudioBuffer<float>&);
-    void processPredelay(juce::AudioBuffer<float>&);
-    void processReadingFreeze(juce::AudioBuffer<float>&);
-    void processCooldown(juce::AudioBuffer<float>&);
-    
-    void fftTest(juce::AudioBuffer<float>&);
+    float getDbLevel () { return engine.getDbLevel(); };
+    bool popTelemetry (AutoFreezeTelemetry& frame) { return engine.popTelemetry(frame); }
+    bool getSpectrumView (AutoFreezeSpectrumView& view) { return engine.getSpectrumView(view); }
+    int getNumGrainUnderruns() const { return engine.getNumGrainUnderruns(); }
+    void setDeterministicSeed (juce::uint64 seed) { engine.setDeterministicSeed(seed); }
+    void setRollingCapture (bool shouldRoll) { engine.setRollingCapture(shouldRoll); }
+    void setCaptureLookbackSeconds (float lookbackSeconds) { engine.setCaptureLookbackSeconds(lookbackSeconds); }
+    void setChannelMode (ChannelMode mode) { engine.setChannelMode(mode); }
+    void setFreezeOrder (int order) { engine.setFreezeOrder(order); }
+    void setNumLayers (int numLayers) { engine.setNumLayers(numLayers); }
+    void setLayerMemoryBudget (std::size_t numBytes) { engine.setLayerMemoryBudget(numBytes); }
+    void setLayerStealing (AutoFreezeEngine::LayerStealing stealing) { engine.setLayerStealing(stealing); }
+    void setSynthesis (AutoFreezeEngine::Synthesis synthesis) { engine.setSynthesis(synthesis); }
+
+    // the largest freeze size memory is set aside for, 2^14 samples unless
+    // asked for more, taken up by the next prepareToPlay
+    void setLargestFreezeOrder (int order) { engine.setLargestFreezeOrder(order); }
+
+    // smaller freezes and half float grains, for sessions with many
+    // instances, taken up by the next prepareToPlay
+    void setCompactMemory (bool shouldBeCompact) { engine.setCompactMemory(shouldBeCompact); }
+
+    juce::AudioProcessorValueTreeState& getParameters() { return parameters; }
+
+    // how the captured freeze is stored in the session, log 16 bit by default
+    void setFreezeStateEncoding (FreezeState::Encoding encoding) { freezeStateEncoding = encoding; }
+
+    // A bank of captured freezes in one file, memory mapped rather than read
+    // in, and remembered with the session. Snapshots are recalled by the
+    // snapshot parameter, 1 upwards, or by MIDI program changes, from 0 and
+    // in banks of 128 set by bank select.
+    bool loadSnapshotBank (const juce::File& bankFile);
+    bool addSnapshotToBank (const juce::File& bankFile);
+    juce::File getSnapshotBankFile() const { return snapshotBankFile; }
 
 
 private:
     //==============================================================================
-    
-    // constants
-    static constexpr int freezeOrder = 14;
-    static constexpr int freezeBufferSamples = 1 << freezeOrder; // = 2^14
-    static constexpr float freezeThresholdDb = -20.0f;
-    static constexpr int numGrains = 4;
-    static constexpr float predelaySeconds = 0.1f;
-    static constexpr float cooldownSeconds = 1.0f;
-    static constexpr float shortFadeSeconds = 0.05f;
-    static constexpr float longFadeSeconds = 0.1f;
-    
-    AutoFreezeState currentState;
-    
-    float dbLevel;
-    
-    // freeze buffer
-    juce::AudioBuffer<float> freezeBuffer;
-    std::vector<float> freezeWindow;
-    int freezeBufferIndex;
-    
-    // grains
-    std::vector<float> grainTargetsRms;
-    juce::dsp::FFT freezeFft{freezeOrder};
-    juce::AudioBuffer<float> freezeMags;
-    std::array<juce::AudioBuffer<float>, numGrains> grains;
-    std::array<int, numGrains> grainIndices;
-    
-    // predelay
-    int predelaySamples;
-    int predelayCounter;
-    
-    // cooldown
-    int cooldownSamples;
-    int coolDownCounter;
-    
-    // short fade
-    int shortFadeSamples;
-    std::vector<float> shortFadeIn;
-    std::vector<float> shortFadeOut;
-    int shortFadeIndex;
-    
-    // long fade
-    int longFadeSamples;
-    std::vector<float> longFadeIn;
-    std::vector<float> longFadeOut;
-    int longFadeIndex;
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    void updateEngineParameters();
+    void restoreParameters (const void* data, int sizeInBytes);
+    void recallSnapshots (const juce::MidiBuffer& midiMessages);
+
+    // the saved state is the parameters as XML followed by the freeze spectrum
+    static constexpr int stateMagic = 0x74734641;   // "AFst"
+    static constexpr int stateVersion = 1;
+
+    AutoFreezeEngine engine;
+    std::atomic<FreezeState::Encoding> freezeStateEncoding { FreezeState::Encoding::Log16 };
+
+    // the raw values are atomics owned by the parameters, so the audio thread
+    // just loads them and hands them on to the engine
+    juce::AudioProcessorValueTreeState parameters;
+    std::atomic<float>* thresholdParameter = nullptr;
+    std::atomic<float>* predelayParameter = nullptr;
+    std::atomic<float>* cooldownParameter = nullptr;
+    std::atomic<float>* shortFadeParameter = nullptr;
+    std::atomic<float>* longFadeParameter = nullptr;
+    std::atomic<float>* morphParameter = nullptr;
+    std::atomic<float>* snapshotParameter = nullptr;
+
+    // snapshot bank
+    std::unique_ptr<juce::MemoryMappedFile> snapshotBankMap;
+    juce::File snapshotBankFile;
         
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AutoFreezeAudioProcessor)